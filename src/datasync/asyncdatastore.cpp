@@ -1,9 +1,12 @@
 #include "asyncdatastore.h"
 #include "asyncdatastore_p.h"
 #include "setup_p.h"
+#include "tasknotifier_p.h"
 
 using namespace QtDataSync;
 
+QAtomicInteger<quint64> AsyncDataStorePrivate::nextOrigin(1);//0 is used for changes that did not come from a store
+
 AsyncDataStore::AsyncDataStore(QObject *parent) :
 	AsyncDataStore(Setup::DefaultSetup, parent)
 {}
@@ -13,9 +16,13 @@ AsyncDataStore::AsyncDataStore(const QString &setupName, QObject *parent) :
 	d(new AsyncDataStorePrivate())
 {
 	d->engine = SetupPrivate::engine(setupName);
+	d->priority = InteractivePriority;
+	d->iterateWindow = 100;
+	d->origin = AsyncDataStorePrivate::nextOrigin.fetchAndAddOrdered(1);
 	Q_ASSERT_X(d->engine, Q_FUNC_INFO, "AsyncDataStore requires a valid setup!");
-	connect(d->engine, &StorageEngine::notifyChanged,
-			this, &AsyncDataStore::dataChanged,
+	//single changes and payloads are only forwarded if someone listens for them (see connectNotify)
+	connect(d->engine, &StorageEngine::notifyChangedBatch,
+			this, &AsyncDataStore::dataChangedBatch,
 			Qt::QueuedConnection);
 	connect(d->engine, &StorageEngine::notifyResetted,
 			this, &AsyncDataStore::dataResetted,
@@ -24,6 +31,31 @@ AsyncDataStore::AsyncDataStore(const QString &setupName, QObject *parent) :
 
 AsyncDataStore::~AsyncDataStore() {}
 
+AsyncDataStore::RequestPriority AsyncDataStore::requestPriority() const
+{
+	return d->priority;
+}
+
+void AsyncDataStore::setRequestPriority(AsyncDataStore::RequestPriority requestPriority)
+{
+	d->priority = requestPriority;
+}
+
+int AsyncDataStore::iterateWindow() const
+{
+	return d->iterateWindow;
+}
+
+void AsyncDataStore::setIterateWindow(int iterateWindow)
+{
+	d->iterateWindow = qMax(iterateWindow, 1);
+}
+
+quint64 AsyncDataStore::origin() const
+{
+	return d->origin;
+}
+
 GenericTask<int> AsyncDataStore::count(int metaTypeId)
 {
 	return internalCount(metaTypeId);
@@ -39,6 +71,11 @@ Task AsyncDataStore::loadAll(int dataMetaTypeId, int listMetaTypeId)
 	return internalLoadAll(dataMetaTypeId, listMetaTypeId);
 }
 
+GenericTask<QList<QVariantMap>> AsyncDataStore::loadAllProjected(int metaTypeId, const QStringList &properties)
+{
+	return internalLoadAllProjected(metaTypeId, properties);
+}
+
 Task AsyncDataStore::load(int metaTypeId, const QString &key)
 {
 	return internalLoad(metaTypeId, key);
@@ -49,6 +86,11 @@ Task AsyncDataStore::load(int metaTypeId, const QVariant &key)
 	return internalLoad(metaTypeId, key.toString());
 }
 
+Task AsyncDataStore::loadMany(int metaTypeId, const QStringList &keys)
+{
+	return internalLoadMany(metaTypeId, keys);
+}
+
 Task AsyncDataStore::save(int metaTypeId, const QVariant &value)
 {
 	return internalSave(metaTypeId, value);
@@ -69,116 +111,207 @@ Task AsyncDataStore::search(int dataMetaTypeId, int listMetaTypeId, const QStrin
 	return internalSearch(dataMetaTypeId, listMetaTypeId, searchQuery);
 }
 
+GenericTask<ChangeSet> AsyncDataStore::changesSince(int metaTypeId, quint64 sequence)
+{
+	return internalChangesSince(metaTypeId, sequence);
+}
+
+QJsonObject AsyncDataStore::serialize(int metaTypeId, const QVariant &value) const
+{
+	return d->engine->serializeValue(metaTypeId, value);
+}
+
+QVariant AsyncDataStore::deserialize(int metaTypeId, const QJsonObject &data) const
+{
+	return d->engine->deserializeValue(metaTypeId, data);
+}
+
+void AsyncDataStore::connectNotify(const QMetaMethod &signal)
+{
+	if(signal == QMetaMethod::fromSignal(&AsyncDataStore::dataChanged) && !d->changedConnection) {
+		d->changedConnection = connect(d->engine, &StorageEngine::notifyChanged,
+									   this, &AsyncDataStore::dataChanged,
+									   Qt::QueuedConnection);
+	} else if(signal == QMetaMethod::fromSignal(&AsyncDataStore::dataChangedPayload) && !d->payloadConnection) {
+		d->payloadConnection = connect(d->engine, &StorageEngine::notifyChangedBatch,
+									   this, &AsyncDataStore::dataChangedPayload,
+									   Qt::QueuedConnection);
+	}
+}
+
+void AsyncDataStore::disconnectNotify(const QMetaMethod &signal)
+{
+	auto changedSignal = QMetaMethod::fromSignal(&AsyncDataStore::dataChanged);
+	if((!signal.isValid() || signal == changedSignal) &&
+	   d->changedConnection &&
+	   !isSignalConnected(changedSignal)) {
+		disconnect(d->changedConnection);
+		d->changedConnection = {};
+	}
+
+	auto payloadSignal = QMetaMethod::fromSignal(&AsyncDataStore::dataChangedPayload);
+	if((!signal.isValid() || signal == payloadSignal) &&
+	   d->payloadConnection &&
+	   !isSignalConnected(payloadSignal)) {
+		disconnect(d->payloadConnection);
+		d->payloadConnection = {};
+	}
+}
+
 void AsyncDataStore::iterate(int metaTypeId, const std::function<bool(QVariant)> &iterator, const std::function<void(const QException &)> &onExcept)
 {
+	auto windowSize = d->iterateWindow;
 	keys(metaTypeId).onResult(this, [=](QStringList keys) {
 		if(!keys.isEmpty()) {
-			load(metaTypeId, keys[0]).onResult(this, [=](QVariant result) {
-				internalIterate(metaTypeId, keys, 0, result, iterator, onExcept);
-			}, onExcept);
+			auto window = internalLoadMany(metaTypeId, keys.mid(0, windowSize));
+			internalIterate(metaTypeId, keys, 0, windowSize, window, iterator, onExcept);
 		}
 	}, onExcept);
 }
 
-QFutureInterface<QVariant> AsyncDataStore::internalCount(int metaTypeId)
+Task AsyncDataStore::internalCount(int metaTypeId)
 {
-	QFutureInterface<QVariant> interface;
-	interface.reportStarted();
-	QMetaObject::invokeMethod(d->engine, "beginTask", Qt::QueuedConnection,
-							  Q_ARG(QFutureInterface<QVariant>, interface),
-							  Q_ARG(QThread*, thread()),
-							  Q_ARG(QtDataSync::StorageEngine::TaskType, StorageEngine::Count),
-							  Q_ARG(int, metaTypeId),
-							  Q_ARG(QVariant, {}));
-	return interface;
+	auto waiter = d->createWaiter(thread());
+	d->engine->submitTask(waiter, StorageEngine::Count, metaTypeId, {}, d->lane());
+	return d->createTask(waiter);
 }
 
-QFutureInterface<QVariant> AsyncDataStore::internalKeys(int metaTypeId)
+Task AsyncDataStore::internalKeys(int metaTypeId)
 {
-	QFutureInterface<QVariant> interface;
-	interface.reportStarted();
-	QMetaObject::invokeMethod(d->engine, "beginTask", Qt::QueuedConnection,
-							  Q_ARG(QFutureInterface<QVariant>, interface),
-							  Q_ARG(QThread*, thread()),
-							  Q_ARG(QtDataSync::StorageEngine::TaskType, StorageEngine::Keys),
-							  Q_ARG(int, metaTypeId),
-							  Q_ARG(QVariant, {}));
-	return interface;
+	auto waiter = d->createWaiter(thread());
+	d->engine->submitTask(waiter, StorageEngine::Keys, metaTypeId, {}, d->lane());
+	return d->createTask(waiter);
 }
 
-QFutureInterface<QVariant> AsyncDataStore::internalLoadAll(int dataMetaTypeId, int listMetaTypeId)
+Task AsyncDataStore::internalLoadAll(int dataMetaTypeId, int listMetaTypeId)
 {
-	QFutureInterface<QVariant> interface;
-	interface.reportStarted();
-	QMetaObject::invokeMethod(d->engine, "beginTask", Qt::QueuedConnection,
-							  Q_ARG(QFutureInterface<QVariant>, interface),
-							  Q_ARG(QThread*, thread()),
-							  Q_ARG(QtDataSync::StorageEngine::TaskType, StorageEngine::LoadAll),
-							  Q_ARG(int, dataMetaTypeId),
-							  Q_ARG(QVariant, listMetaTypeId));
-	return interface;
+	auto waiter = d->createWaiter(thread());
+	d->engine->submitTask(waiter, StorageEngine::LoadAll, dataMetaTypeId, listMetaTypeId, d->lane());
+	return d->createTask(waiter);
 }
 
-QFutureInterface<QVariant> AsyncDataStore::internalLoad(int metaTypeId, const QString &key)
+Task AsyncDataStore::internalLoadAllProjected(int metaTypeId, const QStringList &properties)
 {
-	QFutureInterface<QVariant> interface;
-	interface.reportStarted();
-	QMetaObject::invokeMethod(d->engine, "beginTask", Qt::QueuedConnection,
-							  Q_ARG(QFutureInterface<QVariant>, interface),
-							  Q_ARG(QThread*, thread()),
-							  Q_ARG(QtDataSync::StorageEngine::TaskType, StorageEngine::Load),
-							  Q_ARG(int, metaTypeId),
-							  Q_ARG(QVariant, key));
-	return interface;
+	auto waiter = d->createWaiter(thread());
+	d->engine->submitTask(waiter, StorageEngine::LoadAllProjected, metaTypeId, properties, d->lane());
+	return d->createTask(waiter);
 }
 
-QFutureInterface<QVariant> AsyncDataStore::internalSave(int metaTypeId, const QVariant &value)
+Task AsyncDataStore::internalLoad(int metaTypeId, const QString &key)
 {
-	QFutureInterface<QVariant> interface;
-	interface.reportStarted();
-	QMetaObject::invokeMethod(d->engine, "beginTask", Qt::QueuedConnection,
-							  Q_ARG(QFutureInterface<QVariant>, interface),
-							  Q_ARG(QThread*, thread()),
-							  Q_ARG(QtDataSync::StorageEngine::TaskType, StorageEngine::Save),
-							  Q_ARG(int, metaTypeId),
-							  Q_ARG(QVariant, value));
-	return interface;
+	auto waiter = d->createWaiter(thread());
+	d->engine->submitTask(waiter, StorageEngine::Load, metaTypeId, key, d->lane());
+	return d->createTask(waiter);
 }
 
-QFutureInterface<QVariant> AsyncDataStore::internalRemove(int metaTypeId, const QString &key)
+Task AsyncDataStore::internalLoadMany(int metaTypeId, const QStringList &keys)
 {
-	QFutureInterface<QVariant> interface;
-	interface.reportStarted();
-	QMetaObject::invokeMethod(d->engine, "beginTask", Qt::QueuedConnection,
-							  Q_ARG(QFutureInterface<QVariant>, interface),
-							  Q_ARG(QThread*, thread()),
-							  Q_ARG(QtDataSync::StorageEngine::TaskType, StorageEngine::Remove),
-							  Q_ARG(int, metaTypeId),
-							  Q_ARG(QVariant, key));
-	return interface;
+	auto waiter = d->createWaiter(thread());
+	d->engine->submitTask(waiter, StorageEngine::LoadMany, metaTypeId, keys, d->lane());
+	return d->createTask(waiter);
+}
+
+Task AsyncDataStore::internalSave(int metaTypeId, const QVariant &value)
+{
+	auto waiter = d->createWaiter(thread());
+	try {
+		//serialize on the calling thread, the engine only has to store the json
+		auto json = d->engine->serializeValue(metaTypeId, value);
+		d->engine->submitTask(waiter, StorageEngine::Save, metaTypeId, json, StorageEngine::Interactive, d->origin);
+	} catch(QException &e) {
+		waiter.futureInterface.reportException(e);
+		d->engine->taskRegistry()->finish(waiter.futureInterface, waiter.taskId);
+	}
+	return d->createTask(waiter);
+}
+
+Task AsyncDataStore::internalRemove(int metaTypeId, const QString &key)
+{
+	auto waiter = d->createWaiter(thread());
+	d->engine->submitTask(waiter, StorageEngine::Remove, metaTypeId, key, StorageEngine::Interactive, d->origin);
+	return d->createTask(waiter);
 }
 
-QFutureInterface<QVariant> AsyncDataStore::internalSearch(int dataMetaTypeId, int listMetaTypeId, const QString &query)
+Task AsyncDataStore::internalSearch(int dataMetaTypeId, int listMetaTypeId, const QString &query)
 {
 	auto data = QVariant::fromValue<QPair<int, QString>>({listMetaTypeId, query});
+	auto waiter = d->createWaiter(thread());
+	d->engine->submitTask(waiter, StorageEngine::Search, dataMetaTypeId, data, d->lane());
+	return d->createTask(waiter);
+}
+
+Task AsyncDataStore::internalChangesSince(int metaTypeId, quint64 sequence)
+{
+	auto waiter = d->createWaiter(thread());
+	d->engine->submitTask(waiter, StorageEngine::ChangesSince, metaTypeId, sequence, d->lane());
+	return d->createTask(waiter);
+}
+
+void AsyncDataStore::internalIterate(int metaTypeId, const QStringList &keys, int offset, int windowSize, Task window, const std::function<bool (QVariant)> &iterator, const std::function<void (const QException &)> &onExcept)
+{
+	window.onResult(this, [=](QVariant result) {
+		//the next window is loaded while this one is passed to the iterator
+		auto nextOffset = offset + windowSize;
+		auto hasNext = nextOffset < keys.size();
+		GenericTask<QVariantHash> nextWindow;
+		if(hasNext)
+			nextWindow = internalLoadMany(metaTypeId, keys.mid(nextOffset, windowSize));
+
+		auto data = result.toHash();
+		for(auto i = offset; i < qMin(nextOffset, keys.size()); i++) {
+			//datasets removed after the keys were loaded are skipped
+			if(!data.contains(keys[i]))
+				continue;
+			if(!iterator(data.take(keys[i]))) {
+				AsyncDataStorePrivate::deleteObjects(data.values());
+				if(hasNext)
+					AsyncDataStorePrivate::discardWindow(this, metaTypeId, nextWindow);
+				return;
+			}
+		}
+
+		if(hasNext)
+			internalIterate(metaTypeId, keys, nextOffset, windowSize, nextWindow, iterator, onExcept);
+	}, onExcept);
+}
+
+// ------------- Private Implementation -------------
+
+StorageEngine::RequestLane AsyncDataStorePrivate::lane() const
+{
+	return priority == AsyncDataStore::BackgroundPriority ?
+				StorageEngine::Background :
+				StorageEngine::Interactive;
+}
+
+StorageEngine::Waiter AsyncDataStorePrivate::createWaiter(QThread *targetThread) const
+{
 	QFutureInterface<QVariant> interface;
 	interface.reportStarted();
-	QMetaObject::invokeMethod(d->engine, "beginTask", Qt::QueuedConnection,
-							  Q_ARG(QFutureInterface<QVariant>, interface),
-							  Q_ARG(QThread*, thread()),
-							  Q_ARG(QtDataSync::StorageEngine::TaskType, StorageEngine::Search),
-							  Q_ARG(int, dataMetaTypeId),
-							  Q_ARG(QVariant, data));
-	return interface;
-}
-
-void AsyncDataStore::internalIterate(int metaTypeId, const QStringList &keys, int index, QVariant res, const std::function<bool (QVariant)> &iterator, const std::function<void (const QException &)> &onExcept)
-{
-	if(iterator(res)) {
-		if(++index < keys.size()) {
-			load(metaTypeId, keys[index]).onResult(this, [=](QVariant result) {
-				internalIterate(metaTypeId, keys, index, result, iterator, onExcept);
-			}, onExcept);
-		}
+	return {interface, targetThread, engine->taskRegistry()->track()};
+}
+
+Task AsyncDataStorePrivate::createTask(const StorageEngine::Waiter &waiter) const
+{
+	return Task(waiter.futureInterface, engine->taskRegistry(), waiter.taskId);
+}
+
+void AsyncDataStorePrivate::discardWindow(QObject *parent, int metaTypeId, Task window)
+{
+	//objects are owned by the caller, so a window that might already be loaded must be cleaned up
+	if(QMetaType::typeFlags(metaTypeId).testFlag(QMetaType::PointerToQObject)) {
+		window.toGeneric<QVariantHash>().onResult(parent, [](QVariantHash result) {
+			deleteObjects(result.values());
+		}, [](const QException &){});
+	} else
+		window.cancel();
+}
+
+void AsyncDataStorePrivate::deleteObjects(const QVariantList &values)
+{
+	foreach(auto value, values) {
+		auto object = value.value<QObject*>();
+		if(object)
+			object->deleteLater();
 	}
 }
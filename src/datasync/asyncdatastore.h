@@ -3,10 +3,14 @@
 
 #include "QtDataSync/qtdatasync_global.h"
 #include "QtDataSync/task.h"
+#include "QtDataSync/changeset.h"
 
 #include <QtCore/qobject.h>
 #include <QtCore/qfuture.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qjsonobject.h>
 #include <QtCore/qmetaobject.h>
+#include <QtCore/qvariant.h>
 #include <functional>
 
 namespace QtDataSync {
@@ -19,7 +23,19 @@ class Q_DATASYNC_EXPORT AsyncDataStore : public QObject
 {
 	Q_OBJECT
 
+	//! The priority the engine uses to schedule read requests of this store
+	Q_PROPERTY(RequestPriority requestPriority READ requestPriority WRITE setRequestPriority)
+	//! The number of datasets iterate() loads ahead in one request
+	Q_PROPERTY(int iterateWindow READ iterateWindow WRITE setIterateWindow)
+
 public:
+	//! Defines how requests of a store are scheduled relative to other requests
+	enum RequestPriority {
+		InteractivePriority,//!< Requests are started before synchronization and background requests
+		BackgroundPriority//!< Read requests are started after all other requests
+	};
+	Q_ENUM(RequestPriority)
+
 	//! Constructs a store for the default setup
 	explicit AsyncDataStore(QObject *parent = nullptr);
 	//! Constructs a store for the given setup
@@ -27,16 +43,31 @@ public:
 	//! Destructor
 	~AsyncDataStore();
 
+	//! @readAcFn{AsyncDataStore::requestPriority}
+	RequestPriority requestPriority() const;
+	//! @writeAcFn{AsyncDataStore::requestPriority}
+	void setRequestPriority(RequestPriority requestPriority);
+	//! @readAcFn{AsyncDataStore::iterateWindow}
+	int iterateWindow() const;
+	//! @writeAcFn{AsyncDataStore::iterateWindow}
+	void setIterateWindow(int iterateWindow);
+	//! Returns the tag the store attaches to all of its changes
+	quint64 origin() const;
+
 	//! @copybrief AsyncDataStore::count()
 	GenericTask<int> count(int metaTypeId);
 	//! @copybrief AsyncDataStore::keys()
 	GenericTask<QStringList> keys(int metaTypeId);
 	//! @copybrief AsyncDataStore::loadAll()
 	Task loadAll(int dataMetaTypeId, int listMetaTypeId);
+	//! @copybrief AsyncDataStore::loadAllProjected(const QStringList &)
+	GenericTask<QList<QVariantMap>> loadAllProjected(int metaTypeId, const QStringList &properties);
 	//! @copybrief AsyncDataStore::load(const QString &)
 	Task load(int metaTypeId, const QString &key);
 	//! @copybrief AsyncDataStore::load(const K &)
 	Task load(int metaTypeId, const QVariant &key);
+	//! @copybrief AsyncDataStore::loadMany(const QStringList &)
+	Task loadMany(int metaTypeId, const QStringList &keys);
 	//! @copybrief AsyncDataStore::save(const T &)
 	Task save(int metaTypeId, const QVariant &value);
 	//! @copybrief AsyncDataStore::remove(const QString &)
@@ -45,6 +76,8 @@ public:
 	Task remove(int metaTypeId, const QVariant &key);
 	//! @copybrief AsyncDataStore::search(const QString &)
 	Task search(int dataMetaTypeId, int listMetaTypeId, const QString &query);
+	//! @copybrief AsyncDataStore::changesSince(quint64)
+	GenericTask<ChangeSet> changesSince(int metaTypeId, quint64 sequence);
 	//! @copybrief AsyncDataStore::iterate(const std::function<bool(T)> &, const std::function<void(const QException &)> &)
 	void iterate(int metaTypeId,
 				 const std::function<bool(QVariant)> &iterator,
@@ -59,12 +92,18 @@ public:
 	//! Loads all existing datasets for the given type
 	template<typename T>
 	GenericTask<QList<T>> loadAll();
+	//! Loads the given properties of all existing datasets for the given type
+	template<typename T>
+	GenericTask<QList<QVariantMap>> loadAllProjected(const QStringList &properties);
 	//! Loads the dataset with the given key for the given type
 	template<typename T>
 	GenericTask<T> load(const QString &key);
 	//! @copybrief AsyncDataStore::load(const QString &)
 	template<typename T, typename K>
 	GenericTask<T> load(const K &key);
+	//! Loads all datasets of the given type with one of the given keys
+	template<typename T>
+	GenericTask<QHash<QString, T>> loadMany(const QStringList &keys);
 	//! Saves the given dataset in the store
 	template<typename T>
 	GenericTask<void> save(const T &value);
@@ -77,6 +116,9 @@ public:
 	//! Searches the store for datasets of the given type where the key matches the query
 	template<typename T>
 	GenericTask<QList<T>> search(const QString &query);
+	//! Returns the keys of all datasets of the given type that changed after the given sequence number
+	template<typename T>
+	GenericTask<ChangeSet> changesSince(quint64 sequence);
 	//! Asynchronously iterates over all existing datasets of the given types
 	template<typename T>
 	void iterate(const std::function<bool(T)> &iterator,
@@ -89,27 +131,52 @@ public:
 	template<typename T, typename K>
 	UpdateTask<T> loadInto(const K &key, const T &object);
 
+	//! @copybrief AsyncDataStore::serialize(const T &) const
+	QJsonObject serialize(int metaTypeId, const QVariant &value) const;
+	//! @copybrief AsyncDataStore::deserialize(const QJsonObject &) const
+	QVariant deserialize(int metaTypeId, const QJsonObject &data) const;
+	//! Serializes a dataset of the given type, the same way the store does when saving it
+	template<typename T>
+	QJsonObject serialize(const T &value) const;
+	//! Deserializes a dataset of the given type, as reported by dataChangedPayload()
+	template<typename T>
+	T deserialize(const QJsonObject &data) const;
+
 Q_SIGNALS:
 	//! Will be emitted when a dataset in the store has changed
 	void dataChanged(int metaTypeId, const QString &key, bool wasDeleted);
+	//! Will be emitted with all datasets of one type that have changed within a short time
+	void dataChangedBatch(int metaTypeId, const QStringList &changed, const QStringList &deleted);
+	//! Like dataChangedBatch(), but with the new data of all changed datasets
+	void dataChangedPayload(int metaTypeId, const QStringList &changed, const QStringList &deleted, const QJsonObject &changedData, quint64 origin);
 	//! Will be emitted when the store has be reset (cleared)
 	void dataResetted();
 
+protected:
+	//! @inherit{QObject::connectNotify}
+	void connectNotify(const QMetaMethod &signal) override;
+	//! @inherit{QObject::disconnectNotify}
+	void disconnectNotify(const QMetaMethod &signal) override;
+
 private:
 	QScopedPointer<AsyncDataStorePrivate> d;
 
-	QFutureInterface<QVariant> internalCount(int metaTypeId);
-	QFutureInterface<QVariant> internalKeys(int metaTypeId);
-	QFutureInterface<QVariant> internalLoadAll(int dataMetaTypeId, int listMetaTypeId);
-	QFutureInterface<QVariant> internalLoad(int metaTypeId, const QString &key);
-	QFutureInterface<QVariant> internalSave(int metaTypeId, const QVariant &value);
-	QFutureInterface<QVariant> internalRemove(int metaTypeId, const QString &key);
-	QFutureInterface<QVariant> internalSearch(int dataMetaTypeId, int listMetaTypeId, const QString &query);
+	Task internalCount(int metaTypeId);
+	Task internalKeys(int metaTypeId);
+	Task internalLoadAll(int dataMetaTypeId, int listMetaTypeId);
+	Task internalLoadAllProjected(int metaTypeId, const QStringList &properties);
+	Task internalLoad(int metaTypeId, const QString &key);
+	Task internalLoadMany(int metaTypeId, const QStringList &keys);
+	Task internalSave(int metaTypeId, const QVariant &value);
+	Task internalRemove(int metaTypeId, const QString &key);
+	Task internalSearch(int dataMetaTypeId, int listMetaTypeId, const QString &query);
+	Task internalChangesSince(int metaTypeId, quint64 sequence);
 
 	void internalIterate(int metaTypeId,
 						 const QStringList &keys,
-						 int index,
-						 QVariant res,
+						 int offset,
+						 int windowSize,
+						 Task window,
 						 const std::function<bool(QVariant)> &iterator,
 						 const std::function<void(const QException &)> &onExcept);
 };
@@ -132,6 +199,12 @@ GenericTask<QList<T>> AsyncDataStore::loadAll()
 	return internalLoadAll(qMetaTypeId<T>(), qMetaTypeId<QList<T>>());
 }
 
+template<typename T>
+GenericTask<QList<QVariantMap>> AsyncDataStore::loadAllProjected(const QStringList &properties)
+{
+	return internalLoadAllProjected(qMetaTypeId<T>(), properties);
+}
+
 template<typename T>
 GenericTask<T> AsyncDataStore::load(const QString &key)
 {
@@ -144,6 +217,22 @@ GenericTask<T> AsyncDataStore::load(const K &key)
 	return internalLoad(qMetaTypeId<T>(), QVariant::fromValue(key).toString());
 }
 
+template<typename T>
+GenericTask<QHash<QString, T>> AsyncDataStore::loadMany(const QStringList &keys)
+{
+	//the engine reports a QVariantHash, the converter allows the task to extract the typed hash
+	static const auto converterRegistered = QMetaType::hasRegisteredConverterFunction<QVariantHash, QHash<QString, T>>() ||
+											QMetaType::registerConverter<QVariantHash, QHash<QString, T>>([](const QVariantHash &data) {
+		QHash<QString, T> result;
+		for(auto it = data.constBegin(); it != data.constEnd(); it++)
+			result.insert(it.key(), it.value().template value<T>());
+		return result;
+	});
+	Q_UNUSED(converterRegistered);
+
+	return internalLoadMany(qMetaTypeId<T>(), keys);
+}
+
 template<typename T>
 GenericTask<void> AsyncDataStore::save(const T &value)
 {
@@ -168,6 +257,24 @@ GenericTask<QList<T>> AsyncDataStore::search(const QString &query)
 	return internalSearch(qMetaTypeId<T>(), qMetaTypeId<QList<T>>(), query);
 }
 
+template<typename T>
+GenericTask<ChangeSet> AsyncDataStore::changesSince(quint64 sequence)
+{
+	return internalChangesSince(qMetaTypeId<T>(), sequence);
+}
+
+template<typename T>
+QJsonObject AsyncDataStore::serialize(const T &value) const
+{
+	return serialize(qMetaTypeId<T>(), QVariant::fromValue(value));
+}
+
+template<typename T>
+T AsyncDataStore::deserialize(const QJsonObject &data) const
+{
+	return deserialize(qMetaTypeId<T>(), data).template value<T>();
+}
+
 template<typename T>
 void AsyncDataStore::iterate(const std::function<bool(T)> &iterator, const std::function<void(const QException &)> &onExcept)
 {
@@ -11,6 +11,20 @@ class Q_DATASYNC_EXPORT AsyncDataStorePrivate
 {
 public:
 	StorageEngine *engine;
+	AsyncDataStore::RequestPriority priority;
+	int iterateWindow;
+	quint64 origin;
+	QMetaObject::Connection changedConnection;
+	QMetaObject::Connection payloadConnection;
+
+	StorageEngine::RequestLane lane() const;
+	StorageEngine::Waiter createWaiter(QThread *targetThread) const;
+	Task createTask(const StorageEngine::Waiter &waiter) const;
+
+	static QAtomicInteger<quint64> nextOrigin;
+
+	static void discardWindow(QObject *parent, int metaTypeId, Task window);
+	static void deleteObjects(const QVariantList &values);
 };
 
 }
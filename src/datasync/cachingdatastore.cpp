@@ -1,7 +1,172 @@
 #include "cachingdatastore.h"
+#include "cachingdatastore_p.h"
+#include "setup_p.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QSaveFile>
+#include <QtCore/QThread>
 
 using namespace QtDataSync;
 
 CachingDataStoreBase::CachingDataStoreBase(QObject *parent) :
 	QObject(parent)
 {}
+
+QSharedPointer<QObject> CachingDataStoreBase::findSharedCache(const QString &setupName, int metaTypeId, int keyMetaTypeId, CacheMode cacheMode)
+{
+	auto key = CachingDataStoreBasePrivate::cacheKey(setupName, metaTypeId, keyMetaTypeId, cacheMode);
+	QMutexLocker _(&CachingDataStoreBasePrivate::cacheMutex);
+	auto it = CachingDataStoreBasePrivate::sharedCaches.find(key);
+	if(it == CachingDataStoreBasePrivate::sharedCaches.end())
+		return {};
+
+	auto cache = it->toStrongRef();
+	if(!cache)//the last store of that cache is gone
+		CachingDataStoreBasePrivate::sharedCaches.erase(it);
+	return cache;
+}
+
+void CachingDataStoreBase::registerSharedCache(const QString &setupName, int metaTypeId, int keyMetaTypeId, CacheMode cacheMode, const QSharedPointer<QObject> &cache)
+{
+	auto key = CachingDataStoreBasePrivate::cacheKey(setupName, metaTypeId, keyMetaTypeId, cacheMode);
+	QMutexLocker _(&CachingDataStoreBasePrivate::cacheMutex);
+	CachingDataStoreBasePrivate::sharedCaches.insert(key, cache);
+}
+
+bool CachingDataStoreBase::snapshotsEnabled(const QString &setupName)
+{
+	auto engine = SetupPrivate::engine(setupName);
+	return engine && engine->cacheSnapshots();
+}
+
+bool CachingDataStoreBase::readSnapshotSequence(const QString &setupName, int metaTypeId, quint64 &sequence)
+{
+	QFile file(CachingDataStoreBasePrivate::snapshotPath(setupName, metaTypeId));
+	if(!file.open(QIODevice::ReadOnly))
+		return false;
+	auto header = file.read(CachingDataStoreBasePrivate::HeaderSize);
+	return CachingDataStoreBasePrivate::readHeader(reinterpret_cast<const uchar*>(header.constData()), header.size(), sequence);
+}
+
+bool CachingDataStoreBase::readSnapshot(const QString &setupName, int metaTypeId, quint64 sequence, const std::function<void(const QString &, const QJsonObject &)> &reader)
+{
+	QFile file(CachingDataStoreBasePrivate::snapshotPath(setupName, metaTypeId));
+	if(!file.open(QIODevice::ReadOnly))
+		return false;
+
+	//the binary json format can be used in place, so mapping the file avoids copying the data
+	QByteArray buffer;
+	auto data = file.map(0, file.size());
+	if(!data) {
+		buffer = file.readAll();
+		data = reinterpret_cast<uchar*>(buffer.data());
+	}
+
+	quint64 fileSequence = 0;
+	if(!CachingDataStoreBasePrivate::readHeader(data, file.size(), fileSequence) ||
+	   fileSequence != sequence)//replaced in the meantime
+		return false;
+
+	auto doc = QJsonDocument::fromRawData(reinterpret_cast<const char*>(data + CachingDataStoreBasePrivate::HeaderSize),
+										  file.size() - CachingDataStoreBasePrivate::HeaderSize,
+										  QJsonDocument::Validate);
+	if(!doc.isObject())
+		return false;
+
+	try {
+		auto object = doc.object();
+		for(auto it = object.constBegin(); it != object.constEnd(); it++)
+			reader(it.key(), it.value().toObject());
+		return true;
+	} catch(QException &e) {
+		qCWarning(loggingCategory(setupName)) << "Failed to read cache snapshot with error:"
+											  << e.what();
+		return false;
+	}
+}
+
+bool CachingDataStoreBase::writeSnapshot(const QString &setupName, int metaTypeId, quint64 sequence, const QJsonObject &data)
+{
+	QSaveFile file(CachingDataStoreBasePrivate::snapshotPath(setupName, metaTypeId, true));
+	if(!file.open(QIODevice::WriteOnly)) {
+		qCWarning(loggingCategory(setupName)) << "Failed to open cache snapshot file" << file.fileName()
+											  << "with error:" << file.errorString();
+		return false;
+	}
+
+	QDataStream stream(&file);
+	stream << CachingDataStoreBasePrivate::SnapshotMagic
+		   << CachingDataStoreBasePrivate::SnapshotVersion
+		   << sequence;
+	auto json = QJsonDocument(data).toBinaryData();
+	stream.writeRawData(json.constData(), json.size());
+	if(stream.status() != QDataStream::Ok || !file.commit()) {
+		qCWarning(loggingCategory(setupName)) << "Failed to write cache snapshot file" << file.fileName()
+											  << "with error:" << file.errorString();
+		return false;
+	} else
+		return true;
+}
+
+const QLoggingCategory &CachingDataStoreBase::loggingCategory(const QString &setupName)
+{
+	auto engine = SetupPrivate::engine(setupName);
+	if(engine)
+		return engine->loggingCategory();
+	else
+		return *QLoggingCategory::defaultCategory();
+}
+
+// ------------- Private Implementation -------------
+
+const quint32 CachingDataStoreBasePrivate::SnapshotMagic = 0x51445353;//"QDSS"
+const quint32 CachingDataStoreBasePrivate::SnapshotVersion = 1;
+const int CachingDataStoreBasePrivate::HeaderSize = 16;//keeps the json data aligned
+QMutex CachingDataStoreBasePrivate::cacheMutex;
+QHash<QByteArray, QWeakPointer<QObject>> CachingDataStoreBasePrivate::sharedCaches;
+
+QByteArray CachingDataStoreBasePrivate::cacheKey(const QString &setupName, int metaTypeId, int keyMetaTypeId, CachingDataStoreBase::CacheMode cacheMode)
+{
+	//caches live on the thread of their first store, so every thread gets its own one
+	return setupName.toUtf8() + '\n' +
+			QByteArray::number(metaTypeId) + ':' +
+			QByteArray::number(keyMetaTypeId) + ':' +
+			QByteArray::number(cacheMode) + ':' +
+			QByteArray::number(reinterpret_cast<quintptr>(QThread::currentThread()));
+}
+
+QString CachingDataStoreBasePrivate::snapshotPath(const QString &setupName, int metaTypeId, bool create)
+{
+	auto engine = SetupPrivate::engine(setupName);
+	if(!engine)
+		return QString();
+
+	auto dir = engine->storageDir();
+	auto dirName = QStringLiteral("snapshots");
+	if(create)
+		dir.mkpath(dirName);
+	if(!dir.cd(dirName))
+		return QString();
+	return dir.absoluteFilePath(QString::fromUtf8(QByteArray(QMetaType::typeName(metaTypeId)).toHex() + ".snapshot"));
+}
+
+bool CachingDataStoreBasePrivate::readHeader(const uchar *data, qint64 size, quint64 &sequence)
+{
+	if(size < HeaderSize)
+		return false;
+
+	QDataStream stream(QByteArray::fromRawData(reinterpret_cast<const char*>(data), HeaderSize));
+	quint32 magic = 0;
+	quint32 version = 0;
+	quint64 headerSequence = 0;
+	stream >> magic >> version >> headerSequence;
+	if(stream.status() != QDataStream::Ok ||
+	   magic != SnapshotMagic ||
+	   version != SnapshotVersion)
+		return false;
+
+	sequence = headerSequence;
+	return true;
+}
@@ -6,7 +6,17 @@
 #include "QtDataSync/setup.h"
 
 #include <QtCore/qobject.h>
+#include <QtCore/qcache.h>
+#include <QtCore/qdebug.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qloggingcategory.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qmetaobject.h>
+#include <QtCore/qset.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtCore/qtimer.h>
 #include <functional>
+#include <limits>
 
 namespace QtDataSync {
 
@@ -16,16 +26,152 @@ class Q_DATASYNC_EXPORT CachingDataStoreBase : public QObject
 	Q_OBJECT
 
 public:
+	//! Defines which data a caching store loads and keeps in memory
+	enum CacheMode {
+		FullCache,//!< All datasets are loaded on construction and kept in memory
+		KeyCache,//!< Only the keys are loaded on construction, datasets are loaded on demand into a bounded cache
+		LazyCache,//!< Nothing is loaded on construction, keys and datasets are loaded on demand
+		ProgressiveCache//!< All datasets are loaded in chunks after construction, and become available one chunk at a time
+	};
+	Q_ENUM(CacheMode)
+
 	//! Constructor
 	explicit CachingDataStoreBase(QObject *parent = nullptr);
 
 Q_SIGNALS:
 	//! Will be emitted once, after the initial data was loaded
 	void storeLoaded();
+	//! Will be emitted whenever a chunk of datasets has been loaded in CachingDataStoreBase::ProgressiveCache mode
+	void loadProgress(int loaded, int total);
+	//! Will be emitted once, after the keys have been loaded on demand in CachingDataStoreBase::LazyCache mode
+	void keysLoaded();
 	//! Will be emitted when a dataset in the store has changed
 	void dataChanged(const QString &key, const QVariant &value);
 	//! Will be emitted when the store has be reset (cleared)
 	void dataResetted();
+
+protected:
+	//! Returns the cache shared by all stores of the given type and mode on the current thread
+	static QSharedPointer<QObject> findSharedCache(const QString &setupName, int metaTypeId, int keyMetaTypeId, CacheMode cacheMode);
+	//! Registers the cache shared by all stores of the given type and mode on the current thread
+	static void registerSharedCache(const QString &setupName, int metaTypeId, int keyMetaTypeId, CacheMode cacheMode, const QSharedPointer<QObject> &cache);
+
+	//! Checks if the given setup keeps snapshots of full caches
+	static bool snapshotsEnabled(const QString &setupName);
+	//! Reads the sequence number of the snapshot of the given type, if there is one
+	static bool readSnapshotSequence(const QString &setupName, int metaTypeId, quint64 &sequence);
+	//! Passes all datasets of the snapshot of the given type to the reader, if the snapshot has the given sequence number
+	static bool readSnapshot(const QString &setupName, int metaTypeId, quint64 sequence, const std::function<void(const QString &, const QJsonObject &)> &reader);
+	//! Replaces the snapshot of the given type by the given datasets
+	static bool writeSnapshot(const QString &setupName, int metaTypeId, quint64 sequence, const QJsonObject &data);
+	//! Returns the logging category of the given setup
+	static const QLoggingCategory &loggingCategory(const QString &setupName);
+};
+
+//! A range of dataset keys from an index of a CachingDataStore, ordered by the indexed property
+template <typename TKey>
+class CachingDataStoreRange
+{
+public:
+	//! The iterator type. Dereferencing it returns the dataset key, key() the property value
+	typedef typename QMultiMap<QVariant, TKey>::const_iterator const_iterator;
+
+	//! Constructs the range from begin to end
+	CachingDataStoreRange(const_iterator begin = const_iterator(), const_iterator end = const_iterator());
+
+	//! Returns an iterator to the first key of the range
+	const_iterator begin() const;
+	//! Returns an iterator behind the last key of the range
+	const_iterator end() const;
+	//! Checks if the range contains no keys
+	bool isEmpty() const;
+	//! Copies all keys of the range to a list
+	QList<TKey> toList() const;
+
+private:
+	const_iterator _begin;
+	const_iterator _end;
+};
+
+//! Internal class of CachingDataStore, that keeps an index sorted by one property
+template <typename TKey>
+class CachingDataStoreIndex
+{
+	Q_DISABLE_COPY(CachingDataStoreIndex)
+
+public:
+	//! Constructor
+	CachingDataStoreIndex(const QMetaProperty &property);
+
+	//! Adds the dataset with the given key or moves it to its new position
+	void insert(const TKey &key, const QVariant &value);
+	//! Removes the dataset with the given key
+	void remove(const TKey &key);
+	//! Removes all datasets
+	void clear();
+
+	//! The indexed property
+	const QMetaProperty property;
+	//! The dataset keys, sorted by the property values
+	QMultiMap<QVariant, TKey> sorted;
+	//! The position of every dataset in the sorted map
+	QHash<TKey, typename QMultiMap<QVariant, TKey>::iterator> positions;
+};
+
+//! Internal class of CachingDataStore, that handles the differences between gadgets and QObjects
+template <typename TType>
+struct CachingDataStoreTraits
+{
+	//! The type the cost function is called with
+	typedef const TType &CostArgument;
+
+	//! Verifies that the type can be stored
+	static void checkType();
+	//! Returns the meta object of the type
+	static const QMetaObject *metaObject();
+	//! Reads the given property of a dataset
+	static QVariant read(const QMetaProperty &property, const TType &value);
+	//! Checks if a loaded dataset can be used
+	static bool isValid(const TType &value);
+	//! Passes the ownership of a dataset to the cache
+	static void adopt(const TType &value, QObject *cache);
+	//! Releases a dataset owned by the cache, once control returns to the event loop
+	static void release(const TType &value);
+	//! Releases a dataset owned by the cache, that is replaced by value
+	static void releaseReplaced(const TType &oldValue, const TType &value);
+	//! Deletes a dataset that was never passed on
+	static void discard(const TType &value);
+	//! Applies value to existing, value becomes the dataset that is kept
+	static void update(TType &existing, TType &value);
+};
+
+//! Internal class of CachingDataStore, specialization for QObject* types
+template <typename TType>
+struct CachingDataStoreTraits<TType*>
+{
+	static_assert(std::is_base_of<QObject, TType>::value, "TType must inherit QObject!");
+
+	//! @copydoc CachingDataStoreTraits::CostArgument
+	typedef const TType *CostArgument;
+
+	//! @copydoc CachingDataStoreTraits::checkType
+	static void checkType();
+	//! @copydoc CachingDataStoreTraits::metaObject
+	static const QMetaObject *metaObject();
+	//! @copydoc CachingDataStoreTraits::read
+	static QVariant read(const QMetaProperty &property, TType *value);
+	//! @copydoc CachingDataStoreTraits::isValid
+	static bool isValid(TType *value);
+	//! @copydoc CachingDataStoreTraits::adopt
+	static void adopt(TType *value, QObject *cache);
+	//! @copydoc CachingDataStoreTraits::release
+	static void release(TType *value);
+	//! @copydoc CachingDataStoreTraits::releaseReplaced
+	static void releaseReplaced(TType *oldValue, TType *value);
+	//! @copydoc CachingDataStoreTraits::discard
+	static void discard(TType *value);
+	//! @copydoc CachingDataStoreTraits::update
+	static void update(TType *&existing, TType *&value);
 };
 
 //! A class to access data synchronously
@@ -33,10 +179,36 @@ template <typename TType, typename TKey = QString>
 class CachingDataStore : public CachingDataStoreBase
 {
 public:
+	//! Calculates the cost of a cached dataset
+	typedef std::function<int(typename CachingDataStoreTraits<TType>::CostArgument)> CostFunction;
+	//! A range of dataset keys from an index
+	typedef CachingDataStoreRange<TKey> IndexRange;
+
 	//! Constructs a store for the default setup
 	explicit CachingDataStore(QObject *parent = nullptr, bool blockingConstruct = false);
 	//! Constructs a store for the given setup
 	explicit CachingDataStore(const QString &setupName, QObject *parent = nullptr, bool blockingConstruct = false);
+	//! Constructs a store with the given cache mode for the default setup
+	explicit CachingDataStore(CacheMode cacheMode, QObject *parent = nullptr, bool blockingConstruct = false);
+	//! Constructs a store with the given cache mode for the given setup
+	explicit CachingDataStore(const QString &setupName, CacheMode cacheMode, QObject *parent = nullptr, bool blockingConstruct = false);
+	//! Destructor
+	~CachingDataStore();
+
+	//! Returns the cache mode the store was constructed with
+	CacheMode cacheMode() const;
+	//! Checks if the initial data has been loaded
+	bool isLoaded() const;
+	//! Returns the maximum total cost of the datasets kept in a bounded cache
+	int cacheLimit() const;
+	//! Sets the maximum total cost of the datasets kept in a bounded cache, for all stores that share the cache
+	void setCacheLimit(int cacheLimit);
+	//! Sets the function used to calculate the cost of a dataset in a bounded cache, for all stores that share the cache
+	void setCostFunction(const CostFunction &costFunction);
+	//! Returns the number of datasets loaded with one request in CachingDataStoreBase::ProgressiveCache mode
+	int loadChunkSize() const;
+	//! Sets the number of datasets loaded with one request in CachingDataStoreBase::ProgressiveCache mode, for all stores that share the cache
+	void setLoadChunkSize(int loadChunkSize);
 
 	//! Counts the number of datasets in the store
 	int count() const;
@@ -44,149 +216,674 @@ public:
 	QList<TKey> keys() const;
 	//! Checks if a dataset with the given key exists
 	bool contains(const TKey &key) const;
+	//! Checks if the dataset with the given key can be loaded without accessing the store
+	bool isCached(const TKey &key) const;
 	//! Loads all existing datasets
 	QList<TType> loadAll() const;
 	//! Loads the dataset with the given key
 	TType load(const TKey &key) const;
+	//! Asynchronously loads the datasets with the given keys into the cache
+	void prefetch(const QList<TKey> &keys);
+	//! Adds an index on the given property, that is kept up to date with the store
+	bool addIndex(const QByteArray &property);
+	//! Checks if an index on the given property exists
+	bool hasIndex(const QByteArray &property) const;
+	//! Returns the keys of all datasets where the indexed property has the given value
+	IndexRange lookup(const QByteArray &property, const QVariant &value) const;
+	//! Returns the keys of all datasets where the indexed property lies between the given values
+	IndexRange range(const QByteArray &property, const QVariant &from, const QVariant &to) const;
+	//! Returns the keys of all datasets, sorted by the indexed property
+	IndexRange sorted(const QByteArray &property) const;
 	//! Saves the given dataset
 	void save(const TType &value);
 	//! Removes the dataset with the given key
 	void remove(const TKey &key);
+	//! Writes a snapshot of all cached datasets, to be used for the next startup
+	bool writeSnapshot();
+	//! Returns the interval in milliseconds in which snapshots are written automatically
+	int snapshotInterval() const;
+	//! Sets the interval in milliseconds in which snapshots are written automatically
+	void setSnapshotInterval(int snapshotInterval);
+	//! Returns the time in milliseconds saved datasets wait for further changes before they are written
+	int writeDelay() const;
+	//! Sets the time in milliseconds saved datasets wait for further changes before they are written
+	void setWriteDelay(int writeDelay);
+	//! Returns the maximum time in milliseconds a saved dataset waits before it is written
+	int maxWriteLatency() const;
+	//! Sets the maximum time in milliseconds a saved dataset waits before it is written
+	void setMaxWriteLatency(int maxWriteLatency);
+	//! Writes all saved datasets that are still waiting to the store
+	void flush();
 
 	//! Shortcut to convert a string to the store key type
 	static TKey toKey(const QString &key);
 
 private:
-	AsyncDataStore *_store;
-	QHash<TKey, TType> _data;
+	typedef CachingDataStoreTraits<TType> Traits;
+
+	struct WriteSettings {
+		int delay;
+		int maxLatency;
+	};
+
+	class Shared : public QObject
+	{
+	public:
+		enum LoadStep {
+			FullLoad,
+			SnapshotCheck,
+			DeltaLoad,
+			KeyLoad,
+			ChunkLoad
+		};
+
+		struct QueuedWrite {
+			qint64 due;
+			qint64 deadline;
+		};
+
+		//evicted datasets are released like removed ones
+		struct CacheEntry {
+			inline CacheEntry(const TType &value) : value(value) {}
+			inline ~CacheEntry() {
+				Traits::release(value);
+			}
+			TType value;
+		};
+
+		Shared(const QString &setupName, CacheMode cacheMode);
+
+		const QString setupName;
+		AsyncDataStore *store;
+		const CacheMode cacheMode;
+		const bool progressive;
+		bool loaded;
+		LoadStep loadStep;
+		int loadGeneration;
+		GenericTask<QVariant> loadTask;
+		int loadChunkSize;
+		QStringList pendingKeys;
+		QSet<QString> loadingKeys;
+		int loadTotal;
+		QHash<TKey, TType> data;
+		QCache<TKey, CacheEntry> cache;
+		CostFunction costFunction;
+		QHash<TKey, TType> dirty;
+		QHash<TKey, int> pendingSaves;
+		QHash<TKey, int> fetchingKeys;//by the id of the request that loads them
+		int fetchId;
+		bool fetchingAll;
+		QSet<TKey> keys;
+		bool keysLoaded;
+		bool keysLoading;
+		QSet<TKey> removedKeys;//removed while the keys are loaded
+		QHash<QByteArray, QSharedPointer<CachingDataStoreIndex<TKey>>> indexes;
+		quint64 snapshotSequence;
+		bool snapshotOutdated;
+		QHash<TKey, QueuedWrite> writeQueue;
+		QElapsedTimer writeClock;
+		QTimer *writeTimer;
+		QList<CachingDataStore*> stores;
 
-	void evalDataChanged(int metaTypeId, const QString &key, bool wasDeleted);
-	void evalDataResetted();
+		static TKey keyOf(const TType &value);
+		static void releaseAll(const QHash<TKey, TType> &values);
+
+		void startFullLoad();
+		void watchLoading();
+		void finishLoading(const QVariant &result);
+		bool finishSnapshotCheck(const ChangeSet &changes);
+		bool loadNextChunk();
+		bool dropPending(const QString &key);
+		void prioritize(const QList<TKey> &keys);
+		bool writeSnapshot();
+		void write(const TKey &key, const WriteSettings &settings);
+		void writeNow(const TKey &key);
+		void scheduleWrites();
+		void writeDue();
+		void flushWrites();
+		void applyKeys(const QStringList &keys);
+		void ensureKeys();
+		void fetch(const QList<TKey> &keys);
+		void fetchAll();
+		void insertData(const TKey &key, const TType &value);
+		bool isCached(const TKey &key) const;
+		bool cachedValue(const TKey &key, TType &value);
+		void cacheValue(const TKey &key, const TType &value);
+		bool takeValue(const TKey &key, TType &value);
+		bool dropValue(const TKey &key, const QString &keyString);
+		void releaseDirty(const TKey &key);
+		void updateIndexes(const TKey &key, const TType &value);
+		void removeFromIndexes(const TKey &key);
+
+		void emitStoreLoaded();
+		void emitLoadProgress();
+		void emitKeysLoaded();
+		void emitDataChanged(const QString &key, const QVariant &value);
+		void emitDataResetted();
+
+		void applyChanged(const QString &key, TType value);
+		void evalDataChanged(int metaTypeId, const QString &key, bool wasDeleted);
+		void evalDataChangedPayload(int metaTypeId, const QStringList &changed, const QStringList &deleted, const QJsonObject &changedData, quint64 origin);
+		void evalDataResetted();
+	};
+
+	QSharedPointer<Shared> d;
+	WriteSettings writeSettings;
+	QTimer *snapshotTimer;
 };
 
-/*!
-@brief CachingDataStore specialization for QObject* types
-@details The main difference of the QObject specialization is the fact, that all QObject
-instances are owned by the store. This means saving will reparent objects to the store, and
-remove will delete them etc.
+// ------------- Index Implementation -------------
 
-@copydetails QtDataSync::CachingDataStore
-*/
-template <typename TType, typename TKey>
-class CachingDataStore<TType*, TKey> : public CachingDataStoreBase
+template <typename TKey>
+CachingDataStoreRange<TKey>::CachingDataStoreRange(const_iterator begin, const_iterator end) :
+	_begin(begin),
+	_end(end)
+{}
+
+template <typename TKey>
+typename CachingDataStoreRange<TKey>::const_iterator CachingDataStoreRange<TKey>::begin() const
 {
-	static_assert(std::is_base_of<QObject, TType>::value, "TType must inherit QObject!");
-public:
-	//!@copydoc CachingDataStore::CachingDataStore(QObject *, bool)
-	explicit CachingDataStore(QObject *parent = nullptr, bool blockingConstruct = false);
-	//!@copydoc CachingDataStore::CachingDataStore(const QString &, QObject *, bool)
-	explicit CachingDataStore(const QString &setupName, QObject *parent = nullptr, bool blockingConstruct = false);
+	return _begin;
+}
 
-	//!@copydoc CachingDataStore::count
-	int count() const;
-	//!@copydoc CachingDataStore::keys
-	QList<TKey> keys() const;
-	//!@copydoc CachingDataStore::contains
-	bool contains(const TKey &key) const;
-	//!@copydoc CachingDataStore::loadAll
-	QList<TType*> loadAll() const;
-	//!@copydoc CachingDataStore::load
-	TType* load(const TKey &key) const;
-	//!@copydoc CachingDataStore::save
-	void save(TType *value);
-	//!@copydoc CachingDataStore::remove
-	void remove(const TKey &key);
+template <typename TKey>
+typename CachingDataStoreRange<TKey>::const_iterator CachingDataStoreRange<TKey>::end() const
+{
+	return _end;
+}
 
-	//!@copydoc CachingDataStore::toKey
-	static TKey toKey(const QString &key);
+template <typename TKey>
+bool CachingDataStoreRange<TKey>::isEmpty() const
+{
+	return _begin == _end;
+}
 
-private:
-	AsyncDataStore *_store;
-	QHash<TKey, TType*> _data;
+template <typename TKey>
+QList<TKey> CachingDataStoreRange<TKey>::toList() const
+{
+	QList<TKey> keys;
+	for(auto it = _begin; it != _end; it++)
+		keys.append(*it);
+	return keys;
+}
 
-	void evalDataChanged(int metaTypeId, const QString &key, bool wasDeleted);
-	void evalDataResetted();
-};
+template <typename TKey>
+CachingDataStoreIndex<TKey>::CachingDataStoreIndex(const QMetaProperty &property) :
+	property(property),
+	sorted(),
+	positions()
+{}
+
+template <typename TKey>
+void CachingDataStoreIndex<TKey>::insert(const TKey &key, const QVariant &value)
+{
+	auto it = positions.find(key);
+	if(it != positions.end()) {
+		if(it->key() == value)//unchanged datasets keep their position
+			return;
+		sorted.erase(*it);
+		*it = sorted.insert(value, key);
+	} else
+		positions.insert(key, sorted.insert(value, key));
+}
+
+template <typename TKey>
+void CachingDataStoreIndex<TKey>::remove(const TKey &key)
+{
+	auto it = positions.find(key);
+	if(it != positions.end()) {
+		sorted.erase(*it);
+		positions.erase(it);
+	}
+}
+
+template <typename TKey>
+void CachingDataStoreIndex<TKey>::clear()
+{
+	sorted.clear();
+	positions.clear();
+}
+
+// ------------- Traits Implementation -------------
+
+template <typename TType>
+void CachingDataStoreTraits<TType>::checkType()
+{
+	if(!QMetaType::typeFlags(qMetaTypeId<TType>()).testFlag(QMetaType::IsGadget))
+		qFatal("You can only store QObjects or Q_GADGETs with QtDataSync! Q_GADGETS are supported as values, QObjects as pointers");
+}
+
+template <typename TType>
+const QMetaObject *CachingDataStoreTraits<TType>::metaObject()
+{
+	return &TType::staticMetaObject;
+}
+
+template <typename TType>
+QVariant CachingDataStoreTraits<TType>::read(const QMetaProperty &property, const TType &value)
+{
+	return property.readOnGadget(&value);
+}
+
+template <typename TType>
+bool CachingDataStoreTraits<TType>::isValid(const TType &)
+{
+	return true;
+}
+
+template <typename TType>
+void CachingDataStoreTraits<TType>::adopt(const TType &, QObject *)
+{}
+
+template <typename TType>
+void CachingDataStoreTraits<TType>::release(const TType &)
+{}
+
+template <typename TType>
+void CachingDataStoreTraits<TType>::releaseReplaced(const TType &, const TType &)
+{}
+
+template <typename TType>
+void CachingDataStoreTraits<TType>::discard(const TType &)
+{}
+
+template <typename TType>
+void CachingDataStoreTraits<TType>::update(TType &existing, TType &value)
+{
+	existing = value;
+}
+
+template <typename TType>
+void CachingDataStoreTraits<TType*>::checkType()
+{}
+
+template <typename TType>
+const QMetaObject *CachingDataStoreTraits<TType*>::metaObject()
+{
+	return &TType::staticMetaObject;
+}
+
+template <typename TType>
+QVariant CachingDataStoreTraits<TType*>::read(const QMetaProperty &property, TType *value)
+{
+	return property.read(value);
+}
+
+template <typename TType>
+bool CachingDataStoreTraits<TType*>::isValid(TType *value)
+{
+	return value != nullptr;
+}
+
+template <typename TType>
+void CachingDataStoreTraits<TType*>::adopt(TType *value, QObject *cache)
+{
+	value->setParent(cache);
+}
+
+template <typename TType>
+void CachingDataStoreTraits<TType*>::release(TType *value)
+{
+	if(value)
+		value->deleteLater();
+}
+
+template <typename TType>
+void CachingDataStoreTraits<TType*>::releaseReplaced(TType *oldValue, TType *value)
+{
+	if(oldValue != value)
+		release(oldValue);
+}
+
+template <typename TType>
+void CachingDataStoreTraits<TType*>::discard(TType *value)
+{
+	delete value;
+}
+
+template <typename TType>
+void CachingDataStoreTraits<TType*>::update(TType *&existing, TType *&value)
+{
+	//existing objects are updated, so pointers to them stay valid
+	Task::updateObject(existing, value);
+	delete value;
+	value = existing;
+}
 
 // ------------- Generic Implementation -------------
 
 template <typename TType, typename TKey>
 CachingDataStore<TType, TKey>::CachingDataStore(QObject *parent, bool blockingConstruct) :
-	CachingDataStore(Setup::DefaultSetup, parent, blockingConstruct)
+	CachingDataStore(Setup::DefaultSetup, FullCache, parent, blockingConstruct)
 {}
 
 template <typename TType, typename TKey>
 CachingDataStore<TType, TKey>::CachingDataStore(const QString &setupName, QObject *parent, bool blockingConstruct) :
+	CachingDataStore(setupName, FullCache, parent, blockingConstruct)
+{}
+
+template <typename TType, typename TKey>
+CachingDataStore<TType, TKey>::CachingDataStore(CacheMode cacheMode, QObject *parent, bool blockingConstruct) :
+	CachingDataStore(Setup::DefaultSetup, cacheMode, parent, blockingConstruct)
+{}
+
+template <typename TType, typename TKey>
+CachingDataStore<TType, TKey>::CachingDataStore(const QString &setupName, CacheMode cacheMode, QObject *parent, bool blockingConstruct) :
 	CachingDataStoreBase(parent),
-	_store(new AsyncDataStore(setupName, this)),
-	_data()
+	d(),
+	writeSettings{0, 5000},
+	snapshotTimer(new QTimer(this))
 {
+	Traits::checkType();
+
 	auto metaTypeId = qMetaTypeId<TType>();
-	auto flags = QMetaType::typeFlags(metaTypeId);
-	if((!flags.testFlag(QMetaType::IsGadget)))
-		qFatal("You can only store QObjects or Q_GADGETs with QtDataSync! Q_GADGETS are supported as values, QObjects as pointers");
+	d = findSharedCache(setupName, metaTypeId, qMetaTypeId<TKey>(), cacheMode).template staticCast<Shared>();
+	if(!d) {
+		d.reset(new Shared(setupName, cacheMode), &QObject::deleteLater);
+		registerSharedCache(setupName, metaTypeId, qMetaTypeId<TKey>(), cacheMode, d);
+	}
 
-	auto resHandler = [=](const QList<TType> &dataList){
-		auto userProp = TType::staticMetaObject.userProperty();
-		foreach(auto data, dataList)
-			_data.insert(userProp.readOnGadget(&data).template value<TKey>(), data);
-		emit storeLoaded();
-	};
+	if(d->loaded)
+		QMetaObject::invokeMethod(this, "storeLoaded", Qt::QueuedConnection);
+	else if(blockingConstruct) {
+		//loading from a snapshot takes more than one step
+		while(!d->loaded)
+			d->finishLoading(d->loadTask.result());
+	}
+	d->stores.append(this);
 
-	if(blockingConstruct)
-		resHandler(_store->loadAll<TType>().result());
-	else
-		_store->loadAll<TType>().onResult(this, resHandler);
+	snapshotTimer->setTimerType(Qt::VeryCoarseTimer);
+	connect(snapshotTimer, &QTimer::timeout, this, [this](){
+		d->writeSnapshot();
+	});
+}
+
+template <typename TType, typename TKey>
+CachingDataStore<TType, TKey>::~CachingDataStore()
+{
+	d->stores.removeOne(this);
+	//the shared cache is deleted later, so waiting writes must not depend on it
+	if(d->stores.isEmpty())
+		d->flushWrites();
+}
+
+template <typename TType, typename TKey>
+CachingDataStoreBase::CacheMode CachingDataStore<TType, TKey>::cacheMode() const
+{
+	return d->progressive ? ProgressiveCache : d->cacheMode;
+}
+
+template <typename TType, typename TKey>
+bool CachingDataStore<TType, TKey>::isLoaded() const
+{
+	return d->loaded;
+}
+
+template <typename TType, typename TKey>
+int CachingDataStore<TType, TKey>::cacheLimit() const
+{
+	return d->cache.maxCost();
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::setCacheLimit(int cacheLimit)
+{
+	d->cache.setMaxCost(cacheLimit);
+}
 
-	connect(_store, &AsyncDataStore::dataChanged,
-			this, &CachingDataStore::evalDataChanged);
-	connect(_store, &AsyncDataStore::dataResetted,
-			this, &CachingDataStore::evalDataResetted);
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::setCostFunction(const CostFunction &costFunction)
+{
+	d->costFunction = costFunction;
+}
+
+template <typename TType, typename TKey>
+int CachingDataStore<TType, TKey>::loadChunkSize() const
+{
+	return d->loadChunkSize;
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::setLoadChunkSize(int loadChunkSize)
+{
+	d->loadChunkSize = qMax(loadChunkSize, 1);
 }
 
 template <typename TType, typename TKey>
 int CachingDataStore<TType, TKey>::count() const
 {
-	return _data.size();
+	if(d->cacheMode == FullCache)
+		return d->data.size();
+	else {
+		d->ensureKeys();
+		return d->keys.size();
+	}
 }
 
 template <typename TType, typename TKey>
 QList<TKey> CachingDataStore<TType, TKey>::keys() const
 {
-	return _data.keys();
+	if(d->cacheMode == FullCache)
+		return d->data.keys();
+	else {
+		d->ensureKeys();
+		return d->keys.toList();
+	}
 }
 
 template<typename TType, typename TKey>
 bool CachingDataStore<TType, TKey>::contains(const TKey &key) const
 {
-	return _data.contains(key);
+	if(d->cacheMode == FullCache)
+		return d->data.contains(key);
+	else {
+		d->ensureKeys();
+		return d->keys.contains(key);
+	}
+}
+
+template<typename TType, typename TKey>
+bool CachingDataStore<TType, TKey>::isCached(const TKey &key) const
+{
+	if(d->cacheMode == FullCache)
+		return d->data.contains(key);
+	else
+		return d->isCached(key);
 }
 
 template <typename TType, typename TKey>
 QList<TType> CachingDataStore<TType, TKey>::loadAll() const
 {
-	return _data.values();
+	if(d->cacheMode == FullCache)
+		return d->data.values();
+
+	//only the cached datasets are returned, the others are reported once they have been loaded
+	auto dataList = d->dirty.values();
+	foreach(auto key, d->cache.keys()) {
+		if(!d->dirty.contains(key))
+			dataList.append(d->cache.object(key)->value);
+	}
+	d->fetchAll();
+	return dataList;
 }
 
 template <typename TType, typename TKey>
 TType CachingDataStore<TType, TKey>::load(const TKey &key) const
 {
-	return _data.value(key);
+	if(d->cacheMode == FullCache) {
+		//not loaded by the progressive cache yet, so it is loaded ahead of the others
+		if(d->dropPending(QVariant::fromValue(key).toString()))
+			d->fetch({key});
+		return d->data.value(key);
+	}
+
+	auto value = TType();
+	if(d->cachedValue(key, value))
+		return value;
+	//cache miss, the dataset is reported once it has been loaded
+	if(!d->keysLoaded || d->keys.contains(key))
+		d->fetch({key});
+	return TType();
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::prefetch(const QList<TKey> &keys)
+{
+	if(d->cacheMode == FullCache) {
+		d->prioritize(keys);
+		return;
+	}
+
+	QList<TKey> missing;
+	foreach(auto key, keys) {
+		if(!d->isCached(key) && (!d->keysLoaded || d->keys.contains(key)))
+			missing.append(key);
+	}
+	d->fetch(missing);
 }
 
 template <typename TType, typename TKey>
 void CachingDataStore<TType, TKey>::save(const TType &value)
 {
-	auto userProp = TType::staticMetaObject.userProperty();
-	_data.insert(userProp.readOnGadget(&value).template value<TKey>(), value);
-	_store->save(value);
+	auto keyVariant = Traits::read(Traits::metaObject()->userProperty(), value);
+	auto key = keyVariant.template value<TKey>();
+	auto keyString = keyVariant.toString();
+
+	d->fetchingKeys.remove(key);
+	if(d->cacheMode == FullCache) {
+		d->dropPending(keyString);
+		d->insertData(key, value);
+	} else {
+		//unsaved datasets are kept outside of the cache, so they cannot be evicted
+		auto oldValue = TType();
+		d->takeValue(key, oldValue);
+		Traits::adopt(value, d.data());
+		Traits::releaseReplaced(oldValue, value);
+		d->dirty.insert(key, value);
+		d->keys.insert(key);
+	}
+	d->write(key, writeSettings);
+	d->emitDataChanged(keyString, QVariant::fromValue(value));
 }
 
 template <typename TType, typename TKey>
 void CachingDataStore<TType, TKey>::remove(const TKey &key)
 {
-	_data.remove(key);
-	_store->remove<TType>(QVariant::fromValue(key).toString());
+	auto keyString = QVariant::fromValue(key).toString();
+	//the dataset might exist in the store without being cached, so it is always removed there
+	auto known = d->dropValue(key, keyString);
+	d->store->template remove<TType>(keyString);
+	if(known)
+		d->emitDataChanged(keyString, QVariant());
+}
+
+template <typename TType, typename TKey>
+bool CachingDataStore<TType, TKey>::writeSnapshot()
+{
+	return d->writeSnapshot();
+}
+
+template <typename TType, typename TKey>
+int CachingDataStore<TType, TKey>::snapshotInterval() const
+{
+	return snapshotTimer->isActive() ? snapshotTimer->interval() : 0;
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::setSnapshotInterval(int snapshotInterval)
+{
+	if(snapshotInterval > 0)
+		snapshotTimer->start(snapshotInterval);
+	else
+		snapshotTimer->stop();
+}
+
+template <typename TType, typename TKey>
+int CachingDataStore<TType, TKey>::writeDelay() const
+{
+	return writeSettings.delay;
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::setWriteDelay(int writeDelay)
+{
+	writeSettings.delay = qMax(writeDelay, 0);
+	if(writeSettings.delay == 0)
+		d->flushWrites();
+}
+
+template <typename TType, typename TKey>
+int CachingDataStore<TType, TKey>::maxWriteLatency() const
+{
+	return writeSettings.maxLatency;
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::setMaxWriteLatency(int maxWriteLatency)
+{
+	writeSettings.maxLatency = qMax(maxWriteLatency, 0);
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::flush()
+{
+	d->flushWrites();
+}
+
+template <typename TType, typename TKey>
+bool CachingDataStore<TType, TKey>::addIndex(const QByteArray &property)
+{
+	if(d->cacheMode != FullCache)
+		return false;
+	if(d->indexes.contains(property))
+		return true;
+
+	auto metaObject = Traits::metaObject();
+	auto propIndex = metaObject->indexOfProperty(property.constData());
+	if(propIndex < 0)
+		return false;
+
+	QSharedPointer<CachingDataStoreIndex<TKey>> index(new CachingDataStoreIndex<TKey>(metaObject->property(propIndex)));
+	for(auto it = d->data.constBegin(); it != d->data.constEnd(); it++)
+		index->insert(it.key(), Traits::read(index->property, *it));
+	d->indexes.insert(property, index);
+	return true;
+}
+
+template <typename TType, typename TKey>
+bool CachingDataStore<TType, TKey>::hasIndex(const QByteArray &property) const
+{
+	return d->indexes.contains(property);
+}
+
+template <typename TType, typename TKey>
+typename CachingDataStore<TType, TKey>::IndexRange CachingDataStore<TType, TKey>::lookup(const QByteArray &property, const QVariant &value) const
+{
+	auto index = d->indexes.value(property);
+	if(!index)
+		return IndexRange();
+	const auto &indexMap = index->sorted;
+	return IndexRange(indexMap.lowerBound(value), indexMap.upperBound(value));
+}
+
+template <typename TType, typename TKey>
+typename CachingDataStore<TType, TKey>::IndexRange CachingDataStore<TType, TKey>::range(const QByteArray &property, const QVariant &from, const QVariant &to) const
+{
+	auto index = d->indexes.value(property);
+	if(!index || to < from)
+		return IndexRange();
+	const auto &indexMap = index->sorted;
+	return IndexRange(indexMap.lowerBound(from), indexMap.upperBound(to));
+}
+
+template <typename TType, typename TKey>
+typename CachingDataStore<TType, TKey>::IndexRange CachingDataStore<TType, TKey>::sorted(const QByteArray &property) const
+{
+	auto index = d->indexes.value(property);
+	if(!index)
+		return IndexRange();
+	const auto &indexMap = index->sorted;
+	return IndexRange(indexMap.constBegin(), indexMap.constEnd());
 }
 
 template<typename TType, typename TKey>
@@ -195,180 +892,729 @@ TKey CachingDataStore<TType, TKey>::toKey(const QString &key)
 	return QVariant(key).value<TKey>();
 }
 
+// ------------- Shared Cache Implementation -------------
+
 template <typename TType, typename TKey>
-void CachingDataStore<TType, TKey>::evalDataChanged(int metaTypeId, const QString &key, bool wasDeleted)
+CachingDataStore<TType, TKey>::Shared::Shared(const QString &setupName, CacheMode cacheMode) :
+	QObject(),
+	setupName(setupName),
+	store(new AsyncDataStore(setupName, this)),
+	cacheMode(cacheMode == ProgressiveCache ? FullCache : cacheMode),//a progressive cache is full once loaded
+	progressive(cacheMode == ProgressiveCache),
+	loaded(false),
+	loadStep(FullLoad),
+	loadGeneration(0),
+	loadTask(),
+	loadChunkSize(100),
+	pendingKeys(),
+	loadingKeys(),
+	loadTotal(0),
+	data(),
+	cache(1000),
+	costFunction(),
+	dirty(),
+	pendingSaves(),
+	fetchingKeys(),
+	fetchId(0),
+	fetchingAll(false),
+	keys(),
+	keysLoaded(false),
+	keysLoading(false),
+	removedKeys(),
+	indexes(),
+	snapshotSequence(0),
+	snapshotOutdated(true),
+	writeQueue(),
+	writeClock(),
+	writeTimer(new QTimer(this)),
+	stores()
 {
-	if(metaTypeId == qMetaTypeId<TType>()) {
-		auto rKey = toKey(key);
-		if(wasDeleted) {
-			_data.remove(rKey);
-			emit dataChanged(key, QVariant());
-		} else {
-			_store->load<TType>(key).onResult(this, [=](const TType &data){
-				_data.insert(rKey, data);
-				emit dataChanged(key, QVariant::fromValue(data));
-			});
-		}
+	switch (cacheMode) {
+	case FullCache:
+	case ProgressiveCache:
+		if(snapshotsEnabled(setupName)) {
+			//the current sequence number is needed to write snapshots later, even if there is none yet
+			snapshotSequence = std::numeric_limits<quint64>::max();
+			readSnapshotSequence(setupName, qMetaTypeId<TType>(), snapshotSequence);
+			loadStep = SnapshotCheck;
+			loadTask = store->changesSince<TType>(snapshotSequence).template toGeneric<QVariant>();
+		} else
+			startFullLoad();
+		break;
+	case KeyCache:
+		loadTask = store->keys<TType>().template toGeneric<QVariant>();
+		break;
+	case LazyCache:
+		//nothing to wait for, but the signal is emitted anyway, so every mode can be used the same way
+		loaded = true;
+		break;
+	default:
+		Q_UNREACHABLE();
+		break;
 	}
+
+	if(!loaded)
+		watchLoading();
+
+	writeClock.start();
+	writeTimer->setSingleShot(true);
+	connect(writeTimer, &QTimer::timeout,
+			this, &Shared::writeDue);
+	connect(store, &AsyncDataStore::dataChangedPayload,
+			this, &Shared::evalDataChangedPayload);
+	connect(store, &AsyncDataStore::dataResetted,
+			this, &Shared::evalDataResetted);
 }
 
 template <typename TType, typename TKey>
-void CachingDataStore<TType, TKey>::evalDataResetted()
+TKey CachingDataStore<TType, TKey>::Shared::keyOf(const TType &value)
 {
-	_data.clear();
-	emit dataResetted();
+	static const auto userProp = Traits::metaObject()->userProperty();
+	return Traits::read(userProp, value).template value<TKey>();
 }
 
-// ------------- Generic Implementation specialisation -------------
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::releaseAll(const QHash<TKey, TType> &values)
+{
+	for(auto it = values.constBegin(); it != values.constEnd(); it++)
+		Traits::release(*it);
+}
 
 template <typename TType, typename TKey>
-CachingDataStore<TType*, TKey>::CachingDataStore(QObject *parent, bool blockingConstruct) :
-	CachingDataStore(Setup::DefaultSetup, parent, blockingConstruct)
-{}
+void CachingDataStore<TType, TKey>::Shared::startFullLoad()
+{
+	if(progressive) {
+		loadStep = KeyLoad;
+		loadTask = store->keys<TType>().template toGeneric<QVariant>();
+	} else {
+		loadStep = FullLoad;
+		loadTask = store->loadAll<TType>().template toGeneric<QVariant>();
+	}
+}
 
 template <typename TType, typename TKey>
-CachingDataStore<TType*, TKey>::CachingDataStore(const QString &setupName, QObject *parent, bool blockingConstruct) :
-	CachingDataStoreBase(parent),
-	_store(new AsyncDataStore(setupName, this)),
-	_data()
-{
-	auto resHandler = [=](const QList<TType*> &dataList){
-		auto userProp = TType::staticMetaObject.userProperty();
-		foreach(auto data, dataList) {
-			data->setParent(this);
-			_data.insert(userProp.read(data).template value<TKey>(), data);
-		}
-		emit storeLoaded();
-	};
+void CachingDataStore<TType, TKey>::Shared::watchLoading()
+{
+	auto generation = ++loadGeneration;
+	loadTask.onResult(this, [this, generation](QVariant result){
+		if(generation == loadGeneration)//otherwise a blocking construct has already moved on
+			finishLoading(result);
+	});
+}
 
-	if(blockingConstruct)
-		resHandler(_store->loadAll<TType*>().result());
-	else
-		_store->loadAll<TType*>().onResult(this, resHandler);
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::finishLoading(const QVariant &result)
+{
+	if(loaded)//a blocking construct was faster
+		return;
 
-	connect(_store, &AsyncDataStore::dataChanged,
-			this, &CachingDataStore::evalDataChanged);
-	connect(_store, &AsyncDataStore::dataResetted,
-			this, &CachingDataStore::evalDataResetted);
+	if(cacheMode == FullCache) {
+		switch (loadStep) {
+		case SnapshotCheck:
+			if(!finishSnapshotCheck(result.value<ChangeSet>()))
+				return;
+			break;
+		case DeltaLoad:
+			foreach(auto variant, result.toHash()) {
+				auto value = variant.template value<TType>();
+				if(Traits::isValid(value))
+					insertData(keyOf(value), value);
+			}
+			break;
+		case FullLoad:
+			foreach(auto value, result.value<QList<TType>>()) {
+				if(Traits::isValid(value))
+					insertData(keyOf(value), value);
+			}
+			break;
+		case KeyLoad:
+			pendingKeys = result.toStringList();
+			loadTotal = pendingKeys.size();
+			if(loadNextChunk())
+				return;
+			break;
+		case ChunkLoad:
+		{
+			auto dataHash = result.toHash();
+			for(auto it = dataHash.constBegin(); it != dataHash.constEnd(); it++) {
+				auto value = it->template value<TType>();
+				if(!Traits::isValid(value))
+					continue;
+				if(!loadingKeys.remove(it.key())) {//changed in the meantime
+					Traits::release(value);
+					continue;
+				}
+				insertData(toKey(it.key()), value);
+				emitDataChanged(it.key(), QVariant::fromValue(value));
+			}
+			loadingKeys.clear();
+			emitLoadProgress();
+			if(loadNextChunk())
+				return;
+			break;
+		}
+		default:
+			Q_UNREACHABLE();
+			break;
+		}
+	} else
+		applyKeys(result.toStringList());
+	loaded = true;
+	emitStoreLoaded();
 }
 
 template <typename TType, typename TKey>
-int CachingDataStore<TType*, TKey>::count() const
+bool CachingDataStore<TType, TKey>::Shared::finishSnapshotCheck(const ChangeSet &changes)
 {
-	return _data.size();
+	auto fileSequence = snapshotSequence;
+	snapshotSequence = changes.sequence;
+
+	auto valid = changes.complete && readSnapshot(setupName, qMetaTypeId<TType>(), fileSequence, [&](const QString &, const QJsonObject &json){
+		auto value = store->deserialize<TType>(json);
+		if(Traits::isValid(value))
+			insertData(keyOf(value), value);
+	});
+
+	if(!valid) {
+		//no usable snapshot, so everything is loaded from the store instead
+		releaseAll(data);
+		data.clear();
+		foreach(auto index, indexes)
+			index->clear();
+		startFullLoad();
+		watchLoading();
+		return false;
+	}
+
+	foreach(auto key, changes.deleted) {
+		auto rKey = toKey(key);
+		Traits::release(data.take(rKey));
+		removeFromIndexes(rKey);
+	}
+	if(changes.changed.isEmpty()) {
+		snapshotOutdated = !changes.deleted.isEmpty();
+		return true;
+	}
+
+	loadStep = DeltaLoad;
+	loadTask = store->loadMany<TType>(changes.changed).template toGeneric<QVariant>();
+	watchLoading();
+	return false;
 }
 
 template <typename TType, typename TKey>
-QList<TKey> CachingDataStore<TType*, TKey>::keys() const
+bool CachingDataStore<TType, TKey>::Shared::loadNextChunk()
 {
-	return _data.keys();
+	if(pendingKeys.isEmpty())
+		return false;
+
+	auto chunk = pendingKeys.mid(0, loadChunkSize);
+	pendingKeys.erase(pendingKeys.begin(), pendingKeys.begin() + chunk.size());
+	loadingKeys = QSet<QString>::fromList(chunk);
+	loadStep = ChunkLoad;
+	//chunks use the background lane, so explicit loads can overtake them
+	store->setRequestPriority(AsyncDataStore::BackgroundPriority);
+	loadTask = store->loadMany<TType>(chunk).template toGeneric<QVariant>();
+	store->setRequestPriority(AsyncDataStore::InteractivePriority);
+	watchLoading();
+	return true;
 }
 
-template<typename TType, typename TKey>
-bool CachingDataStore<TType *, TKey>::contains(const TKey &key) const
+template <typename TType, typename TKey>
+bool CachingDataStore<TType, TKey>::Shared::dropPending(const QString &key)
 {
-	return _data.contains(key);
+	if(loaded || !progressive)
+		return false;
+	//removing the key from the loading chunk makes sure the loaded dataset is discarded
+	return pendingKeys.removeOne(key) || loadingKeys.remove(key);
 }
 
 template <typename TType, typename TKey>
-QList<TType*> CachingDataStore<TType*, TKey>::loadAll() const
+void CachingDataStore<TType, TKey>::Shared::prioritize(const QList<TKey> &keys)
 {
-	return _data.values();
+	if(loaded || !progressive)
+		return;
+
+	//pending keys are loaded in order, so the requested ones are moved to the front
+	QStringList prioritized;
+	foreach(auto key, keys) {
+		auto keyString = QVariant::fromValue(key).toString();
+		if(pendingKeys.removeOne(keyString))
+			prioritized.append(keyString);
+	}
+	pendingKeys = prioritized + pendingKeys;
 }
 
 template <typename TType, typename TKey>
-TType *CachingDataStore<TType*, TKey>::load(const TKey &key) const
+bool CachingDataStore<TType, TKey>::Shared::writeSnapshot()
 {
-	return _data.value(key);
+	if(cacheMode != FullCache || !loaded || !snapshotsEnabled(setupName))
+		return false;
+	if(!snapshotOutdated)
+		return true;
+	//the snapshot must not contain datasets the store does not know about yet
+	flushWrites();
+
+	try {
+		QJsonObject json;
+		for(auto it = data.constBegin(); it != data.constEnd(); it++)
+			json.insert(QVariant::fromValue(it.key()).toString(), store->serialize<TType>(*it));
+		if(!CachingDataStoreBase::writeSnapshot(setupName, qMetaTypeId<TType>(), snapshotSequence, json))
+			return false;
+		snapshotOutdated = false;
+		return true;
+	} catch(QException &e) {
+		qCWarning(loggingCategory(setupName)) << "Failed to write cache snapshot with error:"
+											  << e.what();
+		return false;
+	}
 }
 
 template <typename TType, typename TKey>
-void CachingDataStore<TType*, TKey>::save(TType *value)
+void CachingDataStore<TType, TKey>::Shared::write(const TKey &key, const WriteSettings &settings)
 {
-	auto userProp = TType::staticMetaObject.userProperty();
-	auto keyVariant = userProp.read(value);
-	auto key = keyVariant.template value<TKey>();
-	auto keyString = keyVariant.toString();
+	if(settings.delay == 0) {
+		if(cacheMode != FullCache)
+			pendingSaves[key]++;
+		writeNow(key);
+		return;
+	}
+
+	//repeated saves only postpone the write, up to the maximum latency
+	auto now = writeClock.elapsed();
+	auto it = writeQueue.find(key);
+	if(it == writeQueue.end()) {
+		if(cacheMode != FullCache)
+			pendingSaves[key]++;
+		writeQueue.insert(key, {now + settings.delay, now + settings.maxLatency});
+	} else
+		it->due = qMin(now + settings.delay, it->deadline);
+	scheduleWrites();
+}
 
-	auto data = _data.value(key, nullptr);
-	if(data == value) {
-		_store->save(value);
-		emit dataChanged(keyString, QVariant::fromValue(value));
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::writeNow(const TKey &key)
+{
+	if(cacheMode == FullCache) {
+		auto it = data.constFind(key);
+		if(it != data.constEnd())
+			store->save(*it);
 	} else {
-		value->setParent(this);
-		_data.insert(key, value);
-		_store->save(value);
-		emit dataChanged(keyString, QVariant::fromValue(value));
-		if(data)
-			data->deleteLater();
+		auto it = dirty.constFind(key);
+		if(it == dirty.constEnd())
+			return;
+		store->save(*it).onResult(this, [this, key](){
+			releaseDirty(key);
+		}, [this, key](const QException &exception){
+			releaseDirty(key);
+			qCCritical(loggingCategory(setupName)) << "Failed to save dataset with error:"
+												   << exception.what();
+		});
 	}
 }
 
 template <typename TType, typename TKey>
-void CachingDataStore<TType*, TKey>::remove(const TKey &key)
+void CachingDataStore<TType, TKey>::Shared::scheduleWrites()
 {
-	auto data = _data.take(key);
-	if(data) {
-		auto keyString = QVariant::fromValue(key).toString();
-		_store->remove<TType*>(keyString);
-		emit dataChanged(keyString, QVariant());
-		data->deleteLater();
+	if(writeQueue.isEmpty()) {
+		writeTimer->stop();
+		return;
 	}
+
+	auto next = std::numeric_limits<qint64>::max();
+	foreach(auto queued, writeQueue)
+		next = qMin(next, queued.due);
+	writeTimer->start(static_cast<int>(qMax<qint64>(next - writeClock.elapsed(), 0)));
 }
 
-template<typename TType, typename TKey>
-TKey CachingDataStore<TType*, TKey>::toKey(const QString &key)
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::writeDue()
 {
-	return QVariant(key).value<TKey>();
+	auto now = writeClock.elapsed();
+	for(auto it = writeQueue.begin(); it != writeQueue.end();) {
+		if(it->due <= now) {
+			auto key = it.key();
+			it = writeQueue.erase(it);
+			writeNow(key);
+		} else
+			it++;
+	}
+	scheduleWrites();
 }
 
 template <typename TType, typename TKey>
-void CachingDataStore<TType*, TKey>::evalDataChanged(int metaTypeId, const QString &key, bool wasDeleted)
+void CachingDataStore<TType, TKey>::Shared::flushWrites()
 {
-	if(metaTypeId == qMetaTypeId<TType*>()) {
+	auto queuedKeys = writeQueue.keys();
+	writeQueue.clear();
+	writeTimer->stop();
+	foreach(auto key, queuedKeys)
+		writeNow(key);
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::applyKeys(const QStringList &keys)
+{
+	foreach(auto key, keys) {
 		auto rKey = toKey(key);
-		if(wasDeleted) {
-			auto data = _data.take(rKey);
-			if(data) {
-				emit dataChanged(key, QVariant());
-				data->deleteLater();
+		if(!removedKeys.contains(rKey))
+			this->keys.insert(rKey);
+	}
+	removedKeys.clear();
+	keysLoaded = true;
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::ensureKeys()
+{
+	if(keysLoaded || keysLoading)
+		return;
+
+	keysLoading = true;
+	store->keys<TType>().onResult(this, [this](const QStringList &keys){
+		keysLoading = false;
+		if(keysLoaded)//the store has been reset in the meantime
+			return;
+		applyKeys(keys);
+		emitKeysLoaded();
+	}, [this](const QException &exception){
+		keysLoading = false;
+		qCWarning(loggingCategory(setupName)) << "Failed to load keys with error:"
+											  << exception.what();
+	});
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::fetch(const QList<TKey> &keys)
+{
+	auto id = ++fetchId;
+	QStringList missing;
+	foreach(auto key, keys) {
+		if(!fetchingKeys.contains(key)) {
+			fetchingKeys.insert(key, id);
+			missing.append(QVariant::fromValue(key).toString());
+		}
+	}
+	if(missing.isEmpty())
+		return;
+
+	store->loadMany<TType>(missing).onResult(this, [this, id, missing](const QHash<QString, TType> &dataHash){
+		for(auto it = dataHash.constBegin(); it != dataHash.constEnd(); it++) {
+			auto key = toKey(it.key());
+			//datasets that have been saved, removed or changed in the meantime are discarded
+			if(fetchingKeys.value(key) != id ||
+			   !Traits::isValid(*it) ||
+			   (cacheMode != FullCache && isCached(key))) {
+				Traits::discard(*it);
+				continue;
 			}
-		} else {
-			if(_data.contains(rKey)) {
-				_store->loadInto<TType*>(key, _data.value(rKey)).onResult(this, [=](TType* data) {
-					auto oldData = _data.value(rKey, nullptr);
-					if(oldData == data)
-						emit dataChanged(key, QVariant::fromValue(data));
-					else {
-						data->setParent(this);
-						_data.insert(rKey, data);
-						emit dataChanged(key, QVariant::fromValue(data));
-						if(oldData)
-							oldData->deleteLater();
-					}
-				});
-			} else {
-				_store->load<TType*>(key).onResult(this, [=](TType* data) {
-					auto oldData = _data.take(rKey);
-					data->setParent(this);
-					_data.insert(rKey, data);
-					emit dataChanged(key, QVariant::fromValue(data));
-					if(oldData)
-						oldData->deleteLater();
-				});
+			if(cacheMode == FullCache)
+				insertData(key, *it);
+			else
+				cacheValue(key, *it);
+			emitDataChanged(it.key(), QVariant::fromValue(*it));
+		}
+		//datasets that do not exist are not part of the result
+		foreach(auto key, missing) {
+			auto rKey = toKey(key);
+			if(fetchingKeys.value(rKey) == id)
+				fetchingKeys.remove(rKey);
+		}
+	}, [this, id, missing](const QException &exception){
+		foreach(auto key, missing) {
+			auto rKey = toKey(key);
+			if(fetchingKeys.value(rKey) == id)
+				fetchingKeys.remove(rKey);
+		}
+		qCWarning(loggingCategory(setupName)) << "Failed to load datasets with error:"
+											  << exception.what();
+	});
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::fetchAll()
+{
+	if(fetchingAll)
+		return;
+
+	fetchingAll = true;
+	store->loadAll<TType>().onResult(this, [this](const QList<TType> &values){
+		fetchingAll = false;
+		foreach(auto value, values) {
+			auto key = keyOf(value);
+			//only datasets the cache does not know about yet are added
+			if(isCached(key) || removedKeys.contains(key) || (keysLoaded && !keys.contains(key))) {
+				Traits::discard(value);
+				continue;
 			}
+			cacheValue(key, value);
+			emitDataChanged(QVariant::fromValue(key).toString(), QVariant::fromValue(value));
+		}
+	}, [this](const QException &exception){
+		fetchingAll = false;
+		qCWarning(loggingCategory(setupName)) << "Failed to load datasets with error:"
+											  << exception.what();
+	});
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::insertData(const TKey &key, const TType &value)
+{
+	Traits::adopt(value, this);
+	auto &slot = data[key];
+	Traits::releaseReplaced(slot, value);
+	slot = value;
+	updateIndexes(key, value);
+}
+
+template <typename TType, typename TKey>
+bool CachingDataStore<TType, TKey>::Shared::isCached(const TKey &key) const
+{
+	return dirty.contains(key) || cache.contains(key);
+}
+
+template <typename TType, typename TKey>
+bool CachingDataStore<TType, TKey>::Shared::cachedValue(const TKey &key, TType &value)
+{
+	auto it = dirty.constFind(key);
+	if(it != dirty.constEnd()) {
+		value = *it;
+		return true;
+	}
+
+	auto entry = cache.object(key);
+	if(!entry)
+		return false;
+	value = entry->value;
+	return true;
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::cacheValue(const TKey &key, const TType &value)
+{
+	Traits::adopt(value, this);
+	cache.insert(key, new CacheEntry(value), costFunction ? costFunction(value) : 1);
+}
+
+template <typename TType, typename TKey>
+bool CachingDataStore<TType, TKey>::Shared::takeValue(const TKey &key, TType &value)
+{
+	auto it = dirty.find(key);
+	if(it != dirty.end()) {
+		value = *it;
+		dirty.erase(it);
+		return true;
+	}
+
+	QScopedPointer<CacheEntry> entry(cache.take(key));
+	if(!entry)
+		return false;
+	value = entry->value;
+	entry->value = TType();
+	return true;
+}
+
+template <typename TType, typename TKey>
+bool CachingDataStore<TType, TKey>::Shared::dropValue(const TKey &key, const QString &keyString)
+{
+	auto value = TType();
+	auto known = false;
+	writeQueue.remove(key);
+	fetchingKeys.remove(key);
+	if(cacheMode == FullCache) {
+		known = data.contains(key);
+		value = data.take(key);
+		known = dropPending(keyString) || known;
+		removeFromIndexes(key);
+	} else {
+		known = takeValue(key, value);
+		pendingSaves.remove(key);
+		known = keys.remove(key) || known;
+		if(!keysLoaded)
+			removedKeys.insert(key);
+	}
+	Traits::release(value);
+	return known;
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::releaseDirty(const TKey &key)
+{
+	auto it = pendingSaves.find(key);
+	if(it == pendingSaves.end() || --(*it) > 0)
+		return;
+
+	pendingSaves.erase(it);
+	auto dirtyIt = dirty.find(key);
+	if(dirtyIt != dirty.end()) {
+		auto value = *dirtyIt;
+		dirty.erase(dirtyIt);
+		cacheValue(key, value);
+	}
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::updateIndexes(const TKey &key, const TType &value)
+{
+	foreach(auto index, indexes)
+		index->insert(key, Traits::read(index->property, value));
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::removeFromIndexes(const TKey &key)
+{
+	foreach(auto index, indexes)
+		index->remove(key);
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::emitStoreLoaded()
+{
+	foreach(auto store, stores) {
+		if(stores.contains(store))//a previous receiver might have deleted it
+			emit store->storeLoaded();
+	}
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::emitLoadProgress()
+{
+	auto loadedCount = loadTotal - pendingKeys.size() - loadingKeys.size();
+	foreach(auto store, stores) {
+		if(stores.contains(store))
+			emit store->loadProgress(loadedCount, loadTotal);
+	}
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::emitKeysLoaded()
+{
+	foreach(auto store, stores) {
+		if(stores.contains(store))//a previous receiver might have deleted it
+			emit store->keysLoaded();
+	}
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::emitDataChanged(const QString &key, const QVariant &value)
+{
+	snapshotOutdated = true;
+	foreach(auto store, stores) {
+		if(stores.contains(store))
+			emit store->dataChanged(key, value);
+	}
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::emitDataResetted()
+{
+	snapshotOutdated = true;
+	foreach(auto store, stores) {
+		if(stores.contains(store))
+			emit store->dataResetted();
+	}
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::applyChanged(const QString &key, TType value)
+{
+	auto rKey = toKey(key);
+	fetchingKeys.remove(rKey);
+	if(cacheMode == FullCache) {
+		//a local save that has not been written yet wins
+		if(writeQueue.contains(rKey)) {
+			Traits::discard(value);
+			return;
+		}
+		dropPending(key);
+		auto it = data.find(rKey);
+		if(it != data.end())
+			Traits::update(*it, value);
+		else {
+			Traits::adopt(value, this);
+			data.insert(rKey, value);
+		}
+		updateIndexes(rKey, value);
+	} else {
+		keys.insert(rKey);
+		//a local save that is still pending wins
+		if(dirty.contains(rKey)) {
+			Traits::discard(value);
+			return;
+		}
+		auto entry = cache.object(rKey);
+		if(entry)
+			Traits::update(entry->value, value);
+		else
+			cacheValue(rKey, value);
+	}
+	emitDataChanged(key, QVariant::fromValue(value));
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::evalDataChanged(int metaTypeId, const QString &key, bool wasDeleted)
+{
+	if(metaTypeId == qMetaTypeId<TType>()) {
+		if(wasDeleted) {
+			if(dropValue(toKey(key), key))
+				emitDataChanged(key, QVariant());
+		} else {
+			store->load<TType>(key).onResult(this, [=](TType value){
+				applyChanged(key, value);
+			});
+		}
+	}
+}
+
+template <typename TType, typename TKey>
+void CachingDataStore<TType, TKey>::Shared::evalDataChangedPayload(int metaTypeId, const QStringList &changed, const QStringList &deleted, const QJsonObject &changedData, quint64 origin)
+{
+	//changes made through the cache have already been applied
+	if(metaTypeId != qMetaTypeId<TType>() || origin == store->origin())
+		return;
+
+	foreach(auto key, deleted)
+		evalDataChanged(metaTypeId, key, true);
+	foreach(auto key, changed) {
+		//the engine passes on what it has written, so the dataset does not have to be loaded again
+		auto it = changedData.constFind(key);
+		if(it == changedData.constEnd()) {
+			evalDataChanged(metaTypeId, key, false);
+			continue;
+		}
+
+		try {
+			auto value = store->deserialize<TType>(it->toObject());
+			if(Traits::isValid(value))
+				applyChanged(key, value);
+			else
+				evalDataChanged(metaTypeId, key, false);
+		} catch(QException &) {
+			evalDataChanged(metaTypeId, key, false);
 		}
 	}
 }
 
 template <typename TType, typename TKey>
-void CachingDataStore<TType*, TKey>::evalDataResetted()
+void CachingDataStore<TType, TKey>::Shared::evalDataResetted()
 {
-	auto data = _data;
-	_data.clear();
-	emit dataResetted();
-	foreach(auto d, data)
-		d->deleteLater();
+	releaseAll(data);
+	releaseAll(dirty);
+	pendingKeys.clear();
+	loadingKeys.clear();
+	writeQueue.clear();
+	writeTimer->stop();
+	data.clear();
+	cache.clear();
+	dirty.clear();
+	pendingSaves.clear();
+	fetchingKeys.clear();
+	keys.clear();
+	keysLoaded = true;
+	removedKeys.clear();
+	foreach(auto index, indexes)
+		index->clear();
+	emitDataResetted();
 }
 
 }
@@ -0,0 +1,32 @@
+#ifndef QTDATASYNC_CACHINGDATASTORE_P_H
+#define QTDATASYNC_CACHINGDATASTORE_P_H
+
+#include "qtdatasync_global.h"
+#include "cachingdatastore.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QWeakPointer>
+
+namespace QtDataSync {
+
+class Q_DATASYNC_EXPORT CachingDataStoreBasePrivate
+{
+	friend class CachingDataStoreBase;
+
+private:
+	static QByteArray cacheKey(const QString &setupName, int metaTypeId, int keyMetaTypeId, CachingDataStoreBase::CacheMode cacheMode);
+	static QString snapshotPath(const QString &setupName, int metaTypeId, bool create = false);
+	static bool readHeader(const uchar *data, qint64 size, quint64 &sequence);
+
+	static const quint32 SnapshotMagic;
+	static const quint32 SnapshotVersion;
+	static const int HeaderSize;
+
+	static QMutex cacheMutex;
+	static QHash<QByteArray, QWeakPointer<QObject>> sharedCaches;
+};
+
+}
+
+#endif // QTDATASYNC_CACHINGDATASTORE_P_H
@@ -0,0 +1,197 @@
+#include "cachingdatastoremodel.h"
+#include "cachingdatastoremodel_p.h"
+
+#include <algorithm>
+
+using namespace QtDataSync;
+
+CachingDataStoreModelBase::CachingDataStoreModelBase(QObject *parent) :
+	QAbstractListModel(parent),
+	d(new CachingDataStoreModelBasePrivate())
+{
+	d->fetchSize = 0;
+	d->batchTimer = new QTimer(this);
+	d->batchTimer->setSingleShot(true);
+	d->batchTimer->setInterval(0);
+	connect(d->batchTimer, &QTimer::timeout,
+			this, &CachingDataStoreModelBase::flush);
+}
+
+CachingDataStoreModelBase::~CachingDataStoreModelBase() {}
+
+int CachingDataStoreModelBase::fetchSize() const
+{
+	return d->fetchSize;
+}
+
+void CachingDataStoreModelBase::setFetchSize(int fetchSize)
+{
+	d->fetchSize = qMax(fetchSize, 0);
+}
+
+int CachingDataStoreModelBase::batchDelay() const
+{
+	return d->batchTimer->interval();
+}
+
+void CachingDataStoreModelBase::setBatchDelay(int batchDelay)
+{
+	d->batchTimer->setInterval(qMax(batchDelay, 0));
+}
+
+int CachingDataStoreModelBase::rowOf(const QString &key) const
+{
+	return d->rowIndex.value(key, -1);
+}
+
+QString CachingDataStoreModelBase::keyAt(int row) const
+{
+	return d->rows.value(row);
+}
+
+int CachingDataStoreModelBase::rowCount(const QModelIndex &parent) const
+{
+	if(parent.isValid())
+		return 0;
+	else
+		return d->rows.size();
+}
+
+bool CachingDataStoreModelBase::canFetchMore(const QModelIndex &parent) const
+{
+	return !parent.isValid() && !d->unfetched.isEmpty();
+}
+
+void CachingDataStoreModelBase::fetchMore(const QModelIndex &parent)
+{
+	if(!canFetchMore(parent))
+		return;
+
+	auto count = d->fetchSize > 0 ? qMin(d->fetchSize, d->unfetched.size()) : d->unfetched.size();
+	auto keys = d->unfetched.mid(0, count);
+	d->unfetched.erase(d->unfetched.begin(), d->unfetched.begin() + count);
+	prepareFetch(keys);
+
+	auto first = d->rows.size();
+	beginInsertRows(QModelIndex(), first, first + count - 1);
+	d->rows.append(keys);
+	d->updateRowIndex(first);
+	endInsertRows();
+}
+
+void CachingDataStoreModelBase::flush()
+{
+	d->batchTimer->stop();
+	if(d->changes.isEmpty())
+		return;
+
+	auto changes = d->changes;
+	auto changeOrder = d->changeOrder;
+	d->changes.clear();
+	d->changeOrder.clear();
+
+	QList<int> removedRows;
+	QList<int> changedRows;
+	QStringList added;
+	foreach(auto key, changeOrder) {
+		auto row = d->rowIndex.value(key, -1);
+		if(changes.value(key)) {
+			if(row >= 0)
+				removedRows.append(row);
+			else
+				d->unfetched.removeOne(key);
+		} else if(row >= 0)
+			changedRows.append(row);
+		else if(!d->unfetched.contains(key))
+			added.append(key);
+	}
+
+	//remove from the back, so the rows of the following ranges stay valid
+	if(!removedRows.isEmpty()) {
+		auto ranges = CachingDataStoreModelBasePrivate::toRanges(removedRows);
+		for(auto i = ranges.size() - 1; i >= 0; i--) {
+			auto range = ranges[i];
+			beginRemoveRows(QModelIndex(), range.first, range.second);
+			for(auto row = range.first; row <= range.second; row++)
+				d->rowIndex.remove(d->rows[row]);
+			d->rows.erase(d->rows.begin() + range.first, d->rows.begin() + range.second + 1);
+			endRemoveRows();
+		}
+		d->updateRowIndex(ranges.first().first);
+
+		//the changed rows have moved as well
+		changedRows.clear();
+		foreach(auto key, changeOrder) {
+			if(!changes.value(key) && d->rowIndex.contains(key))
+				changedRows.append(d->rowIndex.value(key));
+		}
+	}
+
+	foreach(auto range, CachingDataStoreModelBasePrivate::toRanges(changedRows))
+		emit dataChanged(index(range.first), index(range.second));
+
+	//new datasets are appended, so existing rows never move
+	if(!added.isEmpty()) {
+		if(d->unfetched.isEmpty()) {
+			auto first = d->rows.size();
+			beginInsertRows(QModelIndex(), first, first + added.size() - 1);
+			d->rows.append(added);
+			d->updateRowIndex(first);
+			endInsertRows();
+		} else
+			d->unfetched.append(added);
+	}
+}
+
+void CachingDataStoreModelBase::resetRows(const QStringList &keys)
+{
+	beginResetModel();
+	d->batchTimer->stop();
+	d->changes.clear();
+	d->changeOrder.clear();
+	d->rows.clear();
+	d->rowIndex.clear();
+	if(d->fetchSize > 0) {
+		d->unfetched = keys;
+	} else {
+		d->unfetched.clear();
+		d->rows = keys;
+		d->updateRowIndex(0);
+	}
+	endResetModel();
+}
+
+void CachingDataStoreModelBase::addChange(const QString &key, bool removed)
+{
+	if(!d->changes.contains(key))
+		d->changeOrder.append(key);
+	d->changes.insert(key, removed);
+	if(!d->batchTimer->isActive())
+		d->batchTimer->start();
+}
+
+void CachingDataStoreModelBase::prepareFetch(const QStringList &keys)
+{
+	Q_UNUSED(keys);
+}
+
+// ------------- Private Implementation -------------
+
+void CachingDataStoreModelBasePrivate::updateRowIndex(int from)
+{
+	for(auto row = from; row < rows.size(); row++)
+		rowIndex.insert(rows[row], row);
+}
+
+QList<QPair<int, int>> CachingDataStoreModelBasePrivate::toRanges(QList<int> rows)
+{
+	QList<QPair<int, int>> ranges;
+	std::sort(rows.begin(), rows.end());
+	foreach(auto row, rows) {
+		if(!ranges.isEmpty() && ranges.last().second + 1 >= row)
+			ranges.last().second = qMax(ranges.last().second, row);
+		else
+			ranges.append({row, row});
+	}
+	return ranges;
+}
@@ -0,0 +1,228 @@
+#ifndef QTDATASYNC_CACHINGDATASTOREMODEL_H
+#define QTDATASYNC_CACHINGDATASTOREMODEL_H
+
+#include "QtDataSync/qtdatasync_global.h"
+#include "QtDataSync/cachingdatastore.h"
+
+#include <QtCore/qabstractitemmodel.h>
+#include <QtCore/qmetaobject.h>
+#include <QtCore/qscopedpointer.h>
+#include <type_traits>
+
+namespace QtDataSync {
+
+class CachingDataStoreModelBasePrivate;
+//! Base class for CachingDataStoreModel, to keep track of the rows
+class Q_DATASYNC_EXPORT CachingDataStoreModelBase : public QAbstractListModel
+{
+	Q_OBJECT
+
+	//! The number of rows fetchMore() adds at once, or 0 to show all rows immediately
+	Q_PROPERTY(int fetchSize READ fetchSize WRITE setFetchSize)
+	//! The time in milliseconds changes are collected before they are applied to the model
+	Q_PROPERTY(int batchDelay READ batchDelay WRITE setBatchDelay)
+
+public:
+	//! Constructor
+	explicit CachingDataStoreModelBase(QObject *parent = nullptr);
+	//! Destructor
+	~CachingDataStoreModelBase();
+
+	//! @readAcFn{CachingDataStoreModelBase::fetchSize}
+	int fetchSize() const;
+	//! @writeAcFn{CachingDataStoreModelBase::fetchSize}
+	void setFetchSize(int fetchSize);
+	//! @readAcFn{CachingDataStoreModelBase::batchDelay}
+	int batchDelay() const;
+	//! @writeAcFn{CachingDataStoreModelBase::batchDelay}
+	void setBatchDelay(int batchDelay);
+
+	//! Returns the row of the dataset with the given key, or -1 if it has no row (yet)
+	int rowOf(const QString &key) const;
+	//! Returns the key of the dataset in the given row
+	QString keyAt(int row) const;
+
+	int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+	bool canFetchMore(const QModelIndex &parent) const override;
+	void fetchMore(const QModelIndex &parent) override;
+
+public Q_SLOTS:
+	//! Applies all collected changes to the model immediately
+	void flush();
+
+protected:
+	//! Replaces all rows by the given keys
+	void resetRows(const QStringList &keys);
+	//! Collects a change of the dataset with the given key, to be applied with the next batch
+	void addChange(const QString &key, bool removed);
+	//! Is called before the given keys are added as rows by fetchMore()
+	virtual void prepareFetch(const QStringList &keys);
+
+private:
+	QScopedPointer<CachingDataStoreModelBasePrivate> d;
+};
+
+//! A list model that presents the datasets of a CachingDataStore
+template <typename TType, typename TKey = QString>
+class CachingDataStoreModel : public CachingDataStoreModelBase
+{
+public:
+	//! The type of the underlying store
+	typedef CachingDataStore<TType, TKey> Store;
+
+	//! Constructs a model with a new store for the default setup
+	explicit CachingDataStoreModel(QObject *parent = nullptr);
+	//! Constructs a model for the given store
+	explicit CachingDataStoreModel(Store *store, QObject *parent = nullptr);
+
+	//! Returns the store the model presents
+	Store *store() const;
+	//! Returns the key of the dataset at the given index
+	TKey key(const QModelIndex &index) const;
+	//! Returns the index of the dataset with the given key
+	QModelIndex indexOf(const TKey &key) const;
+	//! Loads the dataset at the given index
+	TType object(const QModelIndex &index) const;
+
+	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+	QHash<int, QByteArray> roleNames() const override;
+
+protected:
+	void prepareFetch(const QStringList &keys) override;
+
+private:
+	typedef typename std::remove_pointer<TType>::type TMeta;
+
+	Store *_store;
+
+	void connectStore();
+
+	template <typename T>
+	static QVariant readProperty(const QMetaProperty &property, const T &gadget);
+	template <typename T>
+	static QVariant readProperty(const QMetaProperty &property, T *object);
+};
+
+// ------------- Generic Implementation -------------
+
+template <typename TType, typename TKey>
+CachingDataStoreModel<TType, TKey>::CachingDataStoreModel(QObject *parent) :
+	CachingDataStoreModel(nullptr, parent)
+{}
+
+template <typename TType, typename TKey>
+CachingDataStoreModel<TType, TKey>::CachingDataStoreModel(Store *store, QObject *parent) :
+	CachingDataStoreModelBase(parent),
+	_store(store ? store : new Store(this))
+{
+	connectStore();
+}
+
+template <typename TType, typename TKey>
+typename CachingDataStoreModel<TType, TKey>::Store *CachingDataStoreModel<TType, TKey>::store() const
+{
+	return _store;
+}
+
+template <typename TType, typename TKey>
+TKey CachingDataStoreModel<TType, TKey>::key(const QModelIndex &index) const
+{
+	return Store::toKey(keyAt(index.row()));
+}
+
+template <typename TType, typename TKey>
+QModelIndex CachingDataStoreModel<TType, TKey>::indexOf(const TKey &key) const
+{
+	auto row = rowOf(QVariant::fromValue(key).toString());
+	return row < 0 ? QModelIndex() : index(row);
+}
+
+template <typename TType, typename TKey>
+TType CachingDataStoreModel<TType, TKey>::object(const QModelIndex &index) const
+{
+	if(!index.isValid() || index.row() >= rowCount())
+		return TType();
+	return _store->load(key(index));
+}
+
+template <typename TType, typename TKey>
+QVariant CachingDataStoreModel<TType, TKey>::data(const QModelIndex &index, int role) const
+{
+	if(role == Qt::DisplayRole)
+		return keyAt(index.row());
+	if(role < Qt::UserRole)
+		return QVariant();
+
+	auto propIndex = role - Qt::UserRole;
+	if(propIndex >= TMeta::staticMetaObject.propertyCount())
+		return QVariant();
+	auto value = object(index);
+	return readProperty(TMeta::staticMetaObject.property(propIndex), value);
+}
+
+template <typename TType, typename TKey>
+QHash<int, QByteArray> CachingDataStoreModel<TType, TKey>::roleNames() const
+{
+	auto roles = CachingDataStoreModelBase::roleNames();
+	for(auto i = 0; i < TMeta::staticMetaObject.propertyCount(); i++)
+		roles.insert(Qt::UserRole + i, TMeta::staticMetaObject.property(i).name());
+	return roles;
+}
+
+template <typename TType, typename TKey>
+void CachingDataStoreModel<TType, TKey>::prepareFetch(const QStringList &keys)
+{
+	QList<TKey> storeKeys;
+	foreach(auto key, keys)
+		storeKeys.append(Store::toKey(key));
+	_store->prefetch(storeKeys);
+}
+
+template <typename TType, typename TKey>
+void CachingDataStoreModel<TType, TKey>::connectStore()
+{
+	auto resetFromStore = [this](){
+		QStringList keys;
+		foreach(auto key, _store->keys())
+			keys.append(QVariant::fromValue(key).toString());
+		resetRows(keys);
+	};
+
+	//progressive stores report loaded datasets as changes, so the rows are already there
+	auto progressive = _store->cacheMode() == CachingDataStoreBase::ProgressiveCache;
+	connect(_store, &CachingDataStoreBase::storeLoaded, this, [this, progressive, resetFromStore](){
+		if(progressive)
+			flush();
+		else
+			resetFromStore();
+	});
+	//lazy stores report no keys until they have been loaded
+	connect(_store, &CachingDataStoreBase::keysLoaded, this, resetFromStore);
+	connect(_store, &CachingDataStoreBase::dataChanged, this, [this](const QString &key, const QVariant &value){
+		addChange(key, !value.isValid());
+	});
+	connect(_store, &CachingDataStoreBase::dataResetted, this, [this](){
+		resetRows({});
+	});
+
+	if(_store->isLoaded() || progressive)
+		resetFromStore();
+}
+
+template <typename TType, typename TKey>
+template <typename T>
+QVariant CachingDataStoreModel<TType, TKey>::readProperty(const QMetaProperty &property, const T &gadget)
+{
+	return property.readOnGadget(&gadget);
+}
+
+template <typename TType, typename TKey>
+template <typename T>
+QVariant CachingDataStoreModel<TType, TKey>::readProperty(const QMetaProperty &property, T *object)
+{
+	return object ? property.read(object) : QVariant();
+}
+
+}
+
+#endif // QTDATASYNC_CACHINGDATASTOREMODEL_H
@@ -0,0 +1,31 @@
+#ifndef QTDATASYNC_CACHINGDATASTOREMODEL_P_H
+#define QTDATASYNC_CACHINGDATASTOREMODEL_P_H
+
+#include "qtdatasync_global.h"
+#include "cachingdatastoremodel.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QStringList>
+#include <QtCore/QTimer>
+
+namespace QtDataSync {
+
+class Q_DATASYNC_EXPORT CachingDataStoreModelBasePrivate
+{
+public:
+	QStringList rows;
+	QHash<QString, int> rowIndex;
+	QStringList unfetched;
+	int fetchSize;
+
+	QTimer *batchTimer;
+	QHash<QString, bool> changes;
+	QStringList changeOrder;
+
+	void updateRowIndex(int from);
+	static QList<QPair<int, int>> toRanges(QList<int> rows);
+};
+
+}
+
+#endif // QTDATASYNC_CACHINGDATASTOREMODEL_P_H
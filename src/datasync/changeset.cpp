@@ -0,0 +1,10 @@
+#include "changeset.h"
+
+using namespace QtDataSync;
+
+ChangeSet::ChangeSet() :
+	sequence(0),
+	complete(true),
+	changed(),
+	deleted()
+{}
@@ -0,0 +1,31 @@
+#ifndef QTDATASYNC_CHANGESET_H
+#define QTDATASYNC_CHANGESET_H
+
+#include "QtDataSync/qtdatasync_global.h"
+
+#include <QtCore/qmetatype.h>
+#include <QtCore/qstringlist.h>
+
+namespace QtDataSync {
+
+//! The changes made to the datasets of one type since a given sequence number
+struct Q_DATASYNC_EXPORT ChangeSet
+{
+	//! Constructor
+	ChangeSet();
+
+	//! The sequence number of the latest change in the store, to be passed to the next query
+	quint64 sequence;
+	//! `false` if the change log does not reach back far enough to contain all changes
+	bool complete;
+	//! The keys of all datasets that have been saved since the given sequence number
+	QStringList changed;
+	//! The keys of all datasets that have been removed since the given sequence number
+	QStringList deleted;
+};
+
+}
+
+Q_DECLARE_METATYPE(QtDataSync::ChangeSet)
+
+#endif // QTDATASYNC_CHANGESET_H
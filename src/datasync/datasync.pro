@@ -9,24 +9,34 @@ HEADERS += \
 	asyncdatastore_p.h \
 	authenticator.h \
 	cachingdatastore.h \
+	cachingdatastore_p.h \
+	cachingdatastoremodel.h \
+	cachingdatastoremodel_p.h \
+	changeset.h \
 	datamerger.h \
 	datamerger_p.h \
 	defaults.h \
 	defaults_p.h \
+	enginestatistics.h \
 	localstore.h \
+	localstore_p.h \
 	remoteconnector.h \
 	setup.h \
 	setup_p.h \
+	slotmap_p.h \
 	stateholder.h \
 	synccontroller.h \
 	synccontroller_p.h \
 	task.h \
+	tasknotifier_p.h \
 	wsauthenticator.h \
 	wsauthenticator_p.h \
 	changecontroller_p.h \
 	sqllocalstore_p.h \
 	sqlstateholder_p.h \
 	storageengine_p.h \
+	storageshard_p.h \
+	propertycopyplan_p.h \
 	wsremoteconnector_p.h \
 	exceptions.h \
 	qtdatasync_global.h \
@@ -37,9 +47,12 @@ SOURCES += \
 	asyncdatastore.cpp \
 	authenticator.cpp \
 	cachingdatastore.cpp \
+	cachingdatastoremodel.cpp \
 	changecontroller.cpp \
+	changeset.cpp \
 	datamerger.cpp \
 	defaults.cpp \
+	enginestatistics.cpp \
 	localstore.cpp \
 	remoteconnector.cpp \
 	setup.cpp \
@@ -47,8 +60,11 @@ SOURCES += \
 	sqlstateholder.cpp \
 	stateholder.cpp \
 	storageengine.cpp \
+	storageshard.cpp \
+	propertycopyplan.cpp \
 	synccontroller.cpp \
 	task.cpp \
+	tasknotifier.cpp \
 	wsauthenticator.cpp \
 	wsremoteconnector.cpp \
 	exceptions.cpp \
@@ -6,12 +6,14 @@
 #include <QtCore/QDebug>
 
 #include <QtSql/QSqlError>
+#include <QtSql/QSqlQuery>
 
 using namespace QtDataSync;
 
 #define LOG d->logCat
 
 const QString DefaultsPrivate::DatabaseName(QStringLiteral("__QtDataSync_default_database"));
+const int DefaultsPrivate::BusyTimeout = 30000;
 
 Defaults::Defaults(const QString &setupName, const QDir &storageDir, const QHash<QByteArray, QVariant> &properties, QObject *parent) :
 	QObject(parent),
@@ -24,7 +26,7 @@ Defaults::Defaults(const QString &setupName, const QDir &storageDir, const QHash
 
 Defaults::~Defaults()
 {
-	if(d->dbRefCounter != 0)
+	if(!d->dbRefCounters.isEmpty())
 		qCWarning(LOG) << "Number of database references is not 0!";
 }
 
@@ -51,23 +53,37 @@ QSettings *Defaults::createSettings(QObject *parent) const
 
 QSqlDatabase Defaults::aquireDatabase()
 {
-	if(d->dbRefCounter++ == 0) {
-		auto database = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), DefaultsPrivate::DatabaseName);
+	QMutexLocker _(&d->dbMutex);
+	auto name = d->databaseName();
+	if(d->dbRefCounters[QThread::currentThread()]++ == 0) {
+		auto database = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), name);
 		database.setDatabaseName(d->storageDir.absoluteFilePath(QStringLiteral("./store.db")));
+		//every thread (e.g. every local store shard) has it's own connection, so writes must wait for each other
+		database.setConnectOptions(QStringLiteral("QSQLITE_BUSY_TIMEOUT=%1").arg(DefaultsPrivate::BusyTimeout));
 		if(!database.open()) {
 			qCCritical(LOG) << "Failed to open database! All subsequent operations will fail! Database error:"
 							<< database.lastError().text();
+		} else {
+			//with write ahead logging, readers of other connections do not block a writer
+			QSqlQuery walQuery(database);
+			if(!walQuery.exec(QStringLiteral("PRAGMA journal_mode=WAL"))) {
+				qCWarning(LOG) << "Failed to enable write ahead logging for the database with error:"
+							   << walQuery.lastError().text();
+			}
 		}
 	}
 
-	return QSqlDatabase::database(DefaultsPrivate::DatabaseName);
+	return QSqlDatabase::database(name);
 }
 
 void Defaults::releaseDatabase()
 {
-	if(--d->dbRefCounter == 0) {
-		QSqlDatabase::database(DefaultsPrivate::DatabaseName).close();
-		QSqlDatabase::removeDatabase(DefaultsPrivate::DatabaseName);
+	QMutexLocker _(&d->dbMutex);
+	auto name = d->databaseName();
+	if(--d->dbRefCounters[QThread::currentThread()] == 0) {
+		d->dbRefCounters.remove(QThread::currentThread());
+		QSqlDatabase::database(name).close();
+		QSqlDatabase::removeDatabase(name);
 	}
 }
 
@@ -75,10 +91,17 @@ void Defaults::releaseDatabase()
 
 QtDataSync::DefaultsPrivate::DefaultsPrivate(const QString &setupName, const QDir &storageDir) :
 	storageDir(storageDir),
-	dbRefCounter(0),
+	dbMutex(),
+	dbRefCounters(),
 	catName("qtdatasync." + setupName.toUtf8()),
 	logCat(catName, QtWarningMsg),
 	settings(nullptr)
 {
 
 }
+
+QString DefaultsPrivate::databaseName() const
+{
+	//one connection per thread, as sql connections must not be shared between threads
+	return DatabaseName + QLatin1Char('_') + QString::number(reinterpret_cast<quintptr>(QThread::currentThread()), 16);
+}
@@ -4,6 +4,9 @@
 #include "qtdatasync_global.h"
 #include "defaults.h"
 
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+
 #include <QtSql/QSqlDatabase>
 
 namespace QtDataSync {
@@ -12,11 +15,15 @@ class Q_DATASYNC_EXPORT DefaultsPrivate
 {
 public:
 	static const QString DatabaseName;
+	static const int BusyTimeout;
 
 	DefaultsPrivate(const QString &setupName, const QDir &storageDir);
 
+	QString databaseName() const;
+
 	QDir storageDir;
-	quint64 dbRefCounter;
+	QMutex dbMutex;
+	QHash<QThread*, quint64> dbRefCounters;
 	QByteArray catName;
 	QLoggingCategory logCat;
 	QSettings *settings;
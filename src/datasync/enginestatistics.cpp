@@ -0,0 +1,26 @@
+#include "enginestatistics.h"
+
+using namespace QtDataSync;
+
+QVector<qint64> EngineStatistics::latencyBuckets()
+{
+	return {
+		100, 250, 500,
+		1000, 2500, 5000,
+		10000, 25000, 50000,
+		100000, 250000, 500000,
+		1000000
+	};
+}
+
+EngineStatistics::EngineStatistics() :
+	queuedRequests(0),
+	activeRequests(0),
+	peakQueuedRequests(0),
+	rejectedRequests(0),
+	delayedRequests(0),
+	coalescedRequests(0),
+	canceledRequests(0),
+	latencyHistograms(),
+	laneWaitHistograms()
+{}
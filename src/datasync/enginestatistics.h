@@ -0,0 +1,42 @@
+#ifndef QTDATASYNC_ENGINESTATISTICS_H
+#define QTDATASYNC_ENGINESTATISTICS_H
+
+#include "QtDataSync/qtdatasync_global.h"
+
+#include <QtCore/qhash.h>
+#include <QtCore/qvector.h>
+
+namespace QtDataSync {
+
+//! A snapshot of the request load of a datasync instance
+struct Q_DATASYNC_EXPORT EngineStatistics
+{
+	//! Returns the upper bounds of the latency histogram buckets, in microseconds
+	static QVector<qint64> latencyBuckets();
+
+	//! Constructor
+	EngineStatistics();
+
+	//! The number of requests waiting to be started by the engine, including delayed ones
+	int queuedRequests;
+	//! The number of requests started, but not yet completed by the local store
+	int activeRequests;
+	//! The highest number of queued requests since the instance was created
+	int peakQueuedRequests;
+	//! The number of requests rejected because the request limit was reached
+	quint64 rejectedRequests;
+	//! The number of requests delayed because the request limit was reached
+	quint64 delayedRequests;
+	//! The number of requests merged into an identical or superseding request
+	quint64 coalescedRequests;
+	//! The number of requests that have been dropped because they were canceled before they started
+	quint64 canceledRequests;
+	//! Completed requests per task type, counted into the latency buckets
+	QHash<QByteArray, QVector<quint64>> latencyHistograms;
+	//! Started requests per scheduling lane, counted into the latency buckets by their wait time
+	QHash<QByteArray, QVector<quint64>> laneWaitHistograms;
+};
+
+}
+
+#endif // QTDATASYNC_ENGINESTATISTICS_H
@@ -103,3 +103,28 @@ QException *DataSyncException::clone() const
 {
 	return new DataSyncException(_what);
 }
+
+EngineOverloadedException::EngineOverloadedException(int requestLimit) :
+	QException(),
+	_what(QStringLiteral("Request rejected, the engine already has %1 pending requests").arg(requestLimit).toUtf8())
+{}
+
+EngineOverloadedException::EngineOverloadedException(const QByteArray &what) :
+	QException(),
+	_what(what)
+{}
+
+const char *EngineOverloadedException::what() const noexcept
+{
+	return _what.constData();
+}
+
+void EngineOverloadedException::raise() const
+{
+	throw *this;
+}
+
+QException *EngineOverloadedException::clone() const
+{
+	return new EngineOverloadedException(_what);
+}
@@ -102,6 +102,27 @@ private:
 	const QByteArray _what;
 };
 
+//! Exception thrown if a request is rejected because the engines request limit was reached
+class Q_DATASYNC_EXPORT EngineOverloadedException : public QException
+{
+public:
+	//! Constructor with the request limit that was reached
+	EngineOverloadedException(int requestLimit);
+
+public:
+	//! @inherit{std::exception::what}
+	const char *what() const noexcept final;
+
+	//! @inherit{QException::raise}
+	void raise() const final;
+	//! @inherit{QException::clone}
+	QException *clone() const final;
+
+private:
+	EngineOverloadedException(const QByteArray &what);
+	const QByteArray _what;
+};
+
 }
 
 #endif // QTDATASYNC_EXCEPTIONS_H
@@ -1,11 +1,52 @@
 #include "localstore.h"
+#include "localstore_p.h"
+#include "changeset.h"
 
 using namespace QtDataSync;
 
 LocalStore::LocalStore(QObject *parent) :
-	QObject(parent)
+	QObject(parent),
+	d(new LocalStorePrivate())
 {}
 
+LocalStore::~LocalStore() {}
+
 void LocalStore::initialize(Defaults *) {}
 
 void LocalStore::finalize() {}
+
+LocalStore *LocalStore::createShard(QObject *)
+{
+	return nullptr;
+}
+
+void LocalStore::loadAllProjected(quint64 id, const QByteArray &typeName, const QStringList &)
+{
+	//the engine removes all other properties from the datasets
+	loadAll(id, typeName);
+}
+
+void LocalStore::loadMany(quint64 id, const QByteArray &typeName, const QStringList &, const QByteArray &)
+{
+	//the engine picks the requested datasets out of the complete list
+	loadAll(id, typeName);
+}
+
+void LocalStore::changesSince(quint64 id, const QByteArray &, quint64)
+{
+	//without a change log, callers have to load everything again
+	ChangeSet changeSet;
+	changeSet.complete = false;
+	emit requestResultReady(id, QVariant::fromValue(changeSet));
+}
+
+bool LocalStore::isCanceled(quint64 id) const
+{
+	return d->cancelCheck && d->cancelCheck(id);
+}
+
+// ------------- Private Implementation -------------
+
+LocalStorePrivate::LocalStorePrivate() :
+	cancelCheck()
+{}
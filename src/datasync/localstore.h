@@ -6,20 +6,25 @@
 
 #include <QtCore/qobject.h>
 #include <QtCore/qstring.h>
+#include <QtCore/qstringlist.h>
 #include <QtCore/qjsonvalue.h>
 #include <QtCore/qjsonobject.h>
 #include <QtCore/qdir.h>
 
 namespace QtDataSync {
 
+class LocalStorePrivate;
 //! The class responsible for storing data locally
 class Q_DATASYNC_EXPORT LocalStore : public QObject
 {
 	Q_OBJECT
+	friend class StorageEngine;
 
 public:
 	//! Constructor
 	explicit LocalStore(QObject *parent = nullptr);
+	//! Destructor
+	~LocalStore();
 
 	//! Called from the engine to initialize the store
 	virtual void initialize(Defaults *defaults);
@@ -31,6 +36,9 @@ public:
 	//! Reset the whole store by deleting all data
 	virtual void resetStore() = 0;
 
+	//! Creates another store instance operating on the same data, to be used as shard
+	virtual LocalStore *createShard(QObject *parent = nullptr);
+
 public Q_SLOTS:
 	//! Count the number of datasets of the given type
 	virtual void count(quint64 id, const QByteArray &typeName) = 0;
@@ -38,20 +46,35 @@ public Q_SLOTS:
 	virtual void keys(quint64 id, const QByteArray &typeName) = 0;
 	//! Load all datasets of the given type
 	virtual void loadAll(quint64 id, const QByteArray &typeName) = 0;
+	//! Load the given properties of all datasets of the given type
+	virtual void loadAllProjected(quint64 id, const QByteArray &typeName, const QStringList &properties);
 	//! Load the datasets of the given type and key, and the specified key property
 	virtual void load(quint64 id, const ObjectKey &key, const QByteArray &keyProperty) = 0;
+	//! Load all datasets of the given type with one of the given keys
+	virtual void loadMany(quint64 id, const QByteArray &typeName, const QStringList &keys, const QByteArray &keyProperty);
 	//! Save the datasets of the given type and key, and the specified key property
 	virtual void save(quint64 id, const ObjectKey &key, const QJsonObject &object, const QByteArray &keyProperty) = 0;
 	//! Remove the datasets of the given type and key, and the specified key property
 	virtual void remove(quint64 id, const ObjectKey &key, const QByteArray &keyProperty) = 0;
 	//! Load all datasets of the given type that match the search query
 	virtual void search(quint64 id, const QByteArray &typeName, const QString &searchQuery) = 0;
+	//! Load the keys of all datasets of the given type that changed after the given sequence number
+	virtual void changesSince(quint64 id, const QByteArray &typeName, quint64 sequence);
 
 Q_SIGNALS:
 	//! Is emitted when a request was completed successfully
 	void requestCompleted(quint64 id, const QJsonValue &result);
+	//! Is emitted when a request was completed successfully, with a result that needs no deserialization
+	void requestResultReady(quint64 id, const QVariant &result);
 	//! Is emitted when a request failed
 	void requestFailed(quint64 id, const QString &errorString);
+
+protected:
+	//! Checks whether everyone waiting for the request with the given id has canceled it
+	bool isCanceled(quint64 id) const;
+
+private:
+	QScopedPointer<LocalStorePrivate> d;
 };
 
 }
@@ -0,0 +1,21 @@
+#ifndef QTDATASYNC_LOCALSTORE_P_H
+#define QTDATASYNC_LOCALSTORE_P_H
+
+#include "qtdatasync_global.h"
+#include "localstore.h"
+
+#include <functional>
+
+namespace QtDataSync {
+
+class Q_DATASYNC_EXPORT LocalStorePrivate
+{
+public:
+	std::function<bool(quint64)> cancelCheck;
+
+	LocalStorePrivate();
+};
+
+}
+
+#endif // QTDATASYNC_LOCALSTORE_P_H
@@ -0,0 +1,53 @@
+#include "propertycopyplan_p.h"
+
+using namespace QtDataSync;
+
+QReadWriteLock PropertyCopyPlan::plansLock;
+QHash<const QMetaObject*, QSharedPointer<const PropertyCopyPlan>> PropertyCopyPlan::plans;
+
+QSharedPointer<const PropertyCopyPlan> PropertyCopyPlan::forClass(const QMetaObject *metaObject)
+{
+	{
+		QReadLocker _(&plansLock);
+		auto plan = plans.value(metaObject);
+		if(plan)
+			return plan;
+	}
+
+	QWriteLocker _(&plansLock);
+	auto &plan = plans[metaObject];
+	if(!plan)//another thread might have been faster
+		plan.reset(new PropertyCopyPlan(metaObject));
+	return plan;
+}
+
+int PropertyCopyPlan::copy(QObject *target, const QObject *source) const
+{
+	auto written = 0;
+	foreach(auto property, properties) {
+		auto value = property.read(source);
+		if(property.read(target) != value) {
+			property.write(target, value);
+			written++;
+		}
+	}
+
+	foreach(auto dynProp, source->dynamicPropertyNames()) {
+		auto value = source->property(dynProp);
+		if(target->property(dynProp) != value) {
+			target->setProperty(dynProp, value);
+			written++;
+		}
+	}
+	return written;
+}
+
+PropertyCopyPlan::PropertyCopyPlan(const QMetaObject *metaObject) :
+	properties()
+{
+	for(auto i = 1; i < metaObject->propertyCount(); i++) {//skip object name
+		auto property = metaObject->property(i);
+		if(property.isStored() && property.isWritable())
+			properties.append(property);
+	}
+}
@@ -0,0 +1,34 @@
+#ifndef QTDATASYNC_PROPERTYCOPYPLAN_P_H
+#define QTDATASYNC_PROPERTYCOPYPLAN_P_H
+
+#include "qtdatasync_global.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QMetaProperty>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QVector>
+
+namespace QtDataSync {
+
+//the stored properties of a class, resolved once per meta object, so updating an object from
+//another one neither walks the meta object nor writes properties that did not change
+class PropertyCopyPlan
+{
+public:
+	static QSharedPointer<const PropertyCopyPlan> forClass(const QMetaObject *metaObject);
+
+	int copy(QObject *target, const QObject *source) const;
+
+private:
+	explicit PropertyCopyPlan(const QMetaObject *metaObject);
+
+	QVector<QMetaProperty> properties;
+
+	static QReadWriteLock plansLock;
+	static QHash<const QMetaObject*, QSharedPointer<const PropertyCopyPlan>> plans;
+};
+
+}
+
+#endif // QTDATASYNC_PROPERTYCOPYPLAN_P_H
@@ -87,6 +87,26 @@ Encryptor *Setup::encryptor() const
 	return d->encryptor.data();
 }
 
+int Setup::storageShards() const
+{
+	return d->storageShards;
+}
+
+int Setup::requestLimit() const
+{
+	return d->requestLimit;
+}
+
+Setup::RequestLimitPolicy Setup::requestLimitPolicy() const
+{
+	return d->requestLimitPolicy;
+}
+
+bool Setup::cacheSnapshots() const
+{
+	return d->cacheSnapshots;
+}
+
 QVariant Setup::property(const QByteArray &key) const
 {
 	return d->properties.value(key);
@@ -140,6 +160,25 @@ Setup &Setup::unsetEncryptor()
 	return *this;
 }
 
+Setup &Setup::setStorageShards(int shards)
+{
+	d->storageShards = qMax(shards, 1);
+	return *this;
+}
+
+Setup &Setup::setRequestLimit(int limit, RequestLimitPolicy policy)
+{
+	d->requestLimit = qMax(limit, 0);
+	d->requestLimitPolicy = policy;
+	return *this;
+}
+
+Setup &Setup::setCacheSnapshots(bool cacheSnapshots)
+{
+	d->cacheSnapshots = cacheSnapshots;
+	return *this;
+}
+
 Setup &Setup::setProperty(const QByteArray &key, const QVariant &data)
 {
 	d->properties.insert(key, data);
@@ -172,7 +211,10 @@ void Setup::create(const QString &name)
 									d->stateHolder.take(),
 									d->remoteConnector.take(),
 									d->dataMerger.take(),
-									d->encryptor.take());
+									d->encryptor.take(),
+									d->storageShards);
+	engine->setRequestLimit(d->requestLimit, d->requestLimitPolicy);
+	engine->setCacheSnapshots(d->cacheSnapshots);
 
 	auto thread = new QThread();
 	engine->moveToThread(thread);
@@ -244,6 +286,10 @@ SetupPrivate::SetupPrivate() :
 	remoteConnector(new WsRemoteConnector()),
 	dataMerger(new DataMerger()),
 	encryptor(new QTinyAesEncryptor()),
+	storageShards(1),
+	requestLimit(0),
+	requestLimitPolicy(Setup::RejectRequests),
+	cacheSnapshots(false),
 	properties()
 {}
 
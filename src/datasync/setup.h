@@ -23,6 +23,12 @@ class Q_DATASYNC_EXPORT Setup
 	Q_DISABLE_COPY(Setup)
 
 public:
+	//! Defines what happens to new requests once the request limit has been reached
+	enum RequestLimitPolicy {
+		RejectRequests,//!< New requests fail with an EngineOverloadedException
+		DelayRequests//!< New requests are held back (and reported as paused) until the queue has room again
+	};
+
 	//! The default setup name
 	static const QString DefaultSetup;
 
@@ -54,6 +60,14 @@ public:
 	DataMerger *dataMerger() const;
 	//! Returns the setups encryptor implementation
 	Encryptor *encryptor() const;
+	//! Returns the number of local store shards the engine distributes types across
+	int storageShards() const;
+	//! Returns the maximum number of requests that may be queued in the engine
+	int requestLimit() const;
+	//! Returns the policy applied to requests once the request limit has been reached
+	RequestLimitPolicy requestLimitPolicy() const;
+	//! Returns whether full caching stores keep snapshots of their data for faster startup
+	bool cacheSnapshots() const;
 	//! Returns the additional property with the given key
 	QVariant property(const QByteArray &key) const;
 
@@ -73,6 +87,12 @@ public:
 	Setup &setEncryptor(Encryptor *encryptor);
 	//! Removes the setups encryptor implementation (data is not encrypted anymore)
 	Setup &unsetEncryptor();
+	//! Sets the number of local store shards the engine distributes types across
+	Setup &setStorageShards(int shards);
+	//! Sets the maximum number of queued requests, and what to do once it has been reached
+	Setup &setRequestLimit(int limit, RequestLimitPolicy policy = RejectRequests);
+	//! Sets whether full caching stores keep snapshots of their data for faster startup
+	Setup &setCacheSnapshots(bool cacheSnapshots);
 	//! Sets the additional property with the given key to data
 	Setup &setProperty(const QByteArray &key, const QVariant &data);
 
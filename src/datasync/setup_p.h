@@ -38,6 +38,10 @@ private:
 	QScopedPointer<RemoteConnector> remoteConnector;
 	QScopedPointer<DataMerger> dataMerger;
 	QScopedPointer<Encryptor> encryptor;
+	int storageShards;
+	int requestLimit;
+	Setup::RequestLimitPolicy requestLimitPolicy;
+	bool cacheSnapshots;
 	QHash<QByteArray, QVariant> properties;
 
 	SetupPrivate();
@@ -0,0 +1,185 @@
+#ifndef QTDATASYNC_SLOTMAP_P_H
+#define QTDATASYNC_SLOTMAP_P_H
+
+#include "qtdatasync_global.h"
+
+#include <QtCore/QList>
+#include <QtCore/QVector>
+
+namespace QtDataSync {
+
+//stores values in reusable slots. keys combine the slot index with a generation counter,
+//so a key of a value that has been taken never matches a newer value in the same slot
+template <typename T>
+class SlotMap
+{
+public:
+	typedef quint64 Key;
+
+	SlotMap();
+
+	Key insert(const T &value);
+	T *find(Key key);
+	const T *find(Key key) const;
+	bool contains(Key key) const;
+	T take(Key key);
+	QList<T> values() const;
+
+	int size() const;
+	bool isEmpty() const;
+	void clear();
+
+private:
+	struct Entry {
+		quint32 generation;
+		bool used;
+		T value;
+
+		Entry();
+	};
+
+	QVector<Entry> entries;
+	QVector<quint32> freeList;
+	int count;
+
+	static quint32 indexOf(Key key);
+	static quint32 generationOf(Key key);
+};
+
+// ------------- Generic Implementation -------------
+
+template <typename T>
+SlotMap<T>::SlotMap() :
+	entries(),
+	freeList(),
+	count(0)
+{}
+
+template <typename T>
+typename SlotMap<T>::Key SlotMap<T>::insert(const T &value)
+{
+	quint32 index;
+	if(freeList.isEmpty()) {
+		index = entries.size();
+		entries.append(Entry());
+	} else {
+		index = freeList.last();
+		freeList.removeLast();
+	}
+
+	auto &entry = entries[index];
+	entry.used = true;
+	entry.value = value;
+	count++;
+	return (static_cast<Key>(entry.generation) << 32) | index;
+}
+
+template <typename T>
+T *SlotMap<T>::find(Key key)
+{
+	auto index = indexOf(key);
+	if(index >= static_cast<quint32>(entries.size()))
+		return nullptr;
+	auto &entry = entries[index];
+	if(!entry.used || entry.generation != generationOf(key))
+		return nullptr;
+	return &entry.value;
+}
+
+template <typename T>
+const T *SlotMap<T>::find(Key key) const
+{
+	auto index = indexOf(key);
+	if(index >= static_cast<quint32>(entries.size()))
+		return nullptr;
+	const auto &entry = entries[index];
+	if(!entry.used || entry.generation != generationOf(key))
+		return nullptr;
+	return &entry.value;
+}
+
+template <typename T>
+bool SlotMap<T>::contains(Key key) const
+{
+	return find(key);
+}
+
+template <typename T>
+T SlotMap<T>::take(Key key)
+{
+	auto value = find(key);
+	if(!value)
+		return T();
+
+	auto index = indexOf(key);
+	auto &entry = entries[index];
+	auto result = entry.value;
+	entry.value = T();
+	entry.used = false;
+	entry.generation++;
+	freeList.append(index);
+	count--;
+	return result;
+}
+
+template <typename T>
+QList<T> SlotMap<T>::values() const
+{
+	QList<T> values;
+	values.reserve(count);
+	foreach(auto entry, entries) {
+		if(entry.used)
+			values.append(entry.value);
+	}
+	return values;
+}
+
+template <typename T>
+int SlotMap<T>::size() const
+{
+	return count;
+}
+
+template <typename T>
+bool SlotMap<T>::isEmpty() const
+{
+	return count == 0;
+}
+
+template <typename T>
+void SlotMap<T>::clear()
+{
+	for(auto i = 0; i < entries.size(); i++) {
+		auto &entry = entries[i];
+		if(entry.used) {
+			entry.value = T();
+			entry.used = false;
+			entry.generation++;
+			freeList.append(i);
+		}
+	}
+	count = 0;
+}
+
+template <typename T>
+quint32 SlotMap<T>::indexOf(Key key)
+{
+	return static_cast<quint32>(key & 0xFFFFFFFFu);
+}
+
+template <typename T>
+quint32 SlotMap<T>::generationOf(Key key)
+{
+	return static_cast<quint32>(key >> 32);
+}
+
+template <typename T>
+SlotMap<T>::Entry::Entry() :
+	generation(0),
+	used(false),
+	value()
+{}
+
+}
+
+#endif // QTDATASYNC_SLOTMAP_P_H
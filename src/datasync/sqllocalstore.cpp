@@ -1,5 +1,6 @@
 #include "defaults.h"
 #include "sqllocalstore_p.h"
+#include "changeset.h"
 
 #include <QtCore/QJsonArray>
 #include <QtCore/QJsonDocument>
@@ -25,6 +26,22 @@ using namespace QtDataSync;
 	} \
 } while(false)
 
+#define EXEC_TRANSACTION_QUERY(query) do {\
+	if(!query.exec()) { \
+		emit requestFailed(id, query.lastError().text()); \
+		database.rollback(); \
+		return; \
+	} \
+} while(false)
+
+//checks for cancellation every 32 files, as reading them is the expensive part
+#define CHECK_CANCELED(index) do {\
+	if((index) % 32 == 0 && isCanceled(id)) { \
+		emit requestFailed(id, QStringLiteral("Request was canceled")); \
+		return; \
+	} \
+} while(false)
+
 SqlLocalStore::SqlLocalStore(QObject *parent) :
 	LocalStore(parent),
 	defaults(nullptr),
@@ -66,6 +83,52 @@ void SqlLocalStore::initialize(Defaults *defaults)
 							<< indexQuery.lastError().text();
 		}
 	}
+
+	//create change log tables
+	if(!database.tables().contains(QStringLiteral("ChangeLog"))) {
+		QSqlQuery createQuery(database);
+		createQuery.prepare(QStringLiteral("CREATE TABLE ChangeLog ("
+												"Seq		INTEGER PRIMARY KEY AUTOINCREMENT,"
+												"Type		TEXT NOT NULL,"
+												"Key		TEXT NOT NULL,"
+												"Deleted	INTEGER NOT NULL,"
+												"UNIQUE(Type, Key)"
+										   ");"));
+		if(!createQuery.exec()) {
+			qCCritical(LOG) << "Failed to create ChangeLog table with error:"
+							<< createQuery.lastError().text();
+		}
+
+		QSqlQuery indexQuery(database);
+		indexQuery.prepare(QStringLiteral("CREATE INDEX index_ChangeLog_Deleted ON ChangeLog (Deleted, Seq)"));
+		if(!indexQuery.exec()) {
+			qCCritical(LOG) << "Failed to create index for ChangeLog with error:"
+							<< indexQuery.lastError().text();
+		}
+
+		//databases from before the change log already contain data, which must be reported as changed
+		QSqlQuery seedQuery(database);
+		seedQuery.prepare(QStringLiteral("INSERT INTO ChangeLog (Type, Key, Deleted) SELECT Type, Key, 0 FROM DataIndex"));
+		if(!seedQuery.exec()) {
+			qCCritical(LOG) << "Failed to seed ChangeLog table with error:"
+							<< seedQuery.lastError().text();
+		}
+	}
+	if(!database.tables().contains(QStringLiteral("ChangeLogHorizon"))) {
+		QSqlQuery createQuery(database);
+		createQuery.prepare(QStringLiteral("CREATE TABLE ChangeLogHorizon (Seq INTEGER NOT NULL);"));
+		if(!createQuery.exec()) {
+			qCCritical(LOG) << "Failed to create ChangeLogHorizon table with error:"
+							<< createQuery.lastError().text();
+		}
+
+		QSqlQuery insertQuery(database);
+		insertQuery.prepare(QStringLiteral("INSERT INTO ChangeLogHorizon (Seq) VALUES(0)"));
+		if(!insertQuery.exec()) {
+			qCCritical(LOG) << "Failed to initialize ChangeLogHorizon table with error:"
+							<< insertQuery.lastError().text();
+		}
+	}
 }
 
 void SqlLocalStore::finalize()
@@ -105,6 +168,27 @@ void SqlLocalStore::resetStore()
 		qCCritical(LOG) << "Failed to remove data keys from database with error:"
 						<< resetQuery.lastError().text();
 	}
+
+	//everyone who saw changes before the reset has to start over
+	QSqlQuery horizonQuery(database);
+	horizonQuery.prepare(QStringLiteral("UPDATE ChangeLogHorizon SET Seq = ?"));
+	horizonQuery.addBindValue(currentSequence());
+	if(!horizonQuery.exec()) {
+		qCCritical(LOG) << "Failed to update the change log horizon with error:"
+						<< horizonQuery.lastError().text();
+	}
+
+	QSqlQuery clearQuery(database);
+	clearQuery.prepare(QStringLiteral("DELETE FROM ChangeLog"));
+	if(!clearQuery.exec()) {
+		qCCritical(LOG) << "Failed to clear the change log with error:"
+						<< clearQuery.lastError().text();
+	}
+}
+
+LocalStore *SqlLocalStore::createShard(QObject *parent)
+{
+	return new SqlLocalStore(parent);
 }
 
 void SqlLocalStore::count(quint64 id, const QByteArray &typeName)
@@ -115,9 +199,9 @@ void SqlLocalStore::count(quint64 id, const QByteArray &typeName)
 	EXEC_QUERY(countQuery);
 
 	if(countQuery.first())
-		emit requestCompleted(id, countQuery.value(0).toInt());
+		emit requestResultReady(id, countQuery.value(0).toInt());
 	else
-		emit requestCompleted(id, 0);
+		emit requestResultReady(id, 0);
 }
 
 void SqlLocalStore::keys(quint64 id, const QByteArray &typeName)
@@ -127,11 +211,11 @@ void SqlLocalStore::keys(quint64 id, const QByteArray &typeName)
 	keysQuery.addBindValue(typeName);
 	EXEC_QUERY(keysQuery);
 
-	QJsonArray resList;
+	QStringList resList;
 	while(keysQuery.next())
 		resList.append(keysQuery.value(0).toString());
 
-	emit requestCompleted(id, resList);
+	emit requestResultReady(id, resList);
 }
 
 void SqlLocalStore::loadAll(quint64 id, const QByteArray &typeName)
@@ -145,6 +229,7 @@ void SqlLocalStore::loadAll(quint64 id, const QByteArray &typeName)
 
 	QJsonArray array;
 	while(loadQuery.next()) {
+		CHECK_CANCELED(array.size());
 		QFile file(tableDir.absoluteFilePath(loadQuery.value(0).toString() + QStringLiteral(".dat")));
 		file.open(QIODevice::ReadOnly);
 		auto doc = QJsonDocument::fromBinaryData(file.readAll());
@@ -162,6 +247,44 @@ void SqlLocalStore::loadAll(quint64 id, const QByteArray &typeName)
 	emit requestCompleted(id, array);
 }
 
+void SqlLocalStore::loadAllProjected(quint64 id, const QByteArray &typeName, const QStringList &properties)
+{
+	TYPE_DIR(id, typeName)
+
+	QSqlQuery loadQuery(database);
+	loadQuery.prepare(QStringLiteral("SELECT File FROM DataIndex WHERE Type = ?"));
+	loadQuery.addBindValue(typeName);
+	EXEC_QUERY(loadQuery);
+
+	QJsonArray array;
+	while(loadQuery.next()) {
+		CHECK_CANCELED(array.size());
+		QFile file(tableDir.absoluteFilePath(loadQuery.value(0).toString() + QStringLiteral(".dat")));
+		file.open(QIODevice::ReadOnly);
+		auto doc = QJsonDocument::fromBinaryData(file.readAll());
+		file.close();
+
+		if(doc.isNull() || file.error() != QFile::NoError) {
+			emit requestFailed(id, QStringLiteral("Failed to read data from file \"%1\" with error: %2")
+							   .arg(file.fileName())
+							   .arg(file.errorString()));
+			return;
+		}
+
+		//the whole document is read and decoded, only the selected values are copied out of it
+		auto object = doc.object();
+		QJsonObject projection;
+		foreach(auto property, properties) {
+			auto it = object.constFind(property);
+			if(it != object.constEnd())
+				projection.insert(property, it.value());
+		}
+		array.append(projection);
+	}
+
+	emit requestCompleted(id, array);
+}
+
 void SqlLocalStore::load(quint64 id, const ObjectKey &key, const QByteArray &)
 {
 	TYPE_DIR(id, key.first)
@@ -191,6 +314,48 @@ void SqlLocalStore::load(quint64 id, const ObjectKey &key, const QByteArray &)
 	}
 }
 
+void SqlLocalStore::loadMany(quint64 id, const QByteArray &typeName, const QStringList &keys, const QByteArray &)
+{
+	TYPE_DIR(id, typeName)
+
+	//sqlite limits the number of bound parameters, so the keys are queried in chunks
+	static const int ChunkSize = 500;
+
+	QJsonObject result;
+	for(auto offset = 0; offset < keys.size(); offset += ChunkSize) {
+		auto chunk = keys.mid(offset, ChunkSize);
+		QStringList placeholders;
+		for(auto i = 0; i < chunk.size(); i++)
+			placeholders.append(QStringLiteral("?"));
+
+		QSqlQuery loadQuery(database);
+		loadQuery.prepare(QStringLiteral("SELECT Key, File FROM DataIndex WHERE Type = ? AND Key IN (%1)")
+						  .arg(placeholders.join(QStringLiteral(", "))));
+		loadQuery.addBindValue(typeName);
+		foreach(auto key, chunk)
+			loadQuery.addBindValue(key);
+		EXEC_QUERY(loadQuery);
+
+		while(loadQuery.next()) {
+			CHECK_CANCELED(result.size());
+			QFile file(tableDir.absoluteFilePath(loadQuery.value(1).toString() + QStringLiteral(".dat")));
+			file.open(QIODevice::ReadOnly);
+			auto doc = QJsonDocument::fromBinaryData(file.readAll());
+			file.close();
+
+			if(doc.isNull() || file.error() != QFile::NoError) {
+				emit requestFailed(id, QStringLiteral("Failed to read data from file \"%1\" with error: %2")
+								   .arg(file.fileName())
+								   .arg(file.errorString()));
+				return;
+			} else
+				result.insert(loadQuery.value(0).toString(), doc.object());
+		}
+	}
+
+	emit requestCompleted(id, result);
+}
+
 void SqlLocalStore::save(quint64 id, const ObjectKey &key, const QJsonObject &object, const QByteArray &)
 {
 	TYPE_DIR(id, key.first)
@@ -228,14 +393,29 @@ void SqlLocalStore::save(quint64 id, const ObjectKey &key, const QJsonObject &ob
 		return;
 	}
 
-	//save key in database
+	//save key in database, together with the change log entry
+	if(!beginTransaction(id))
+		return;
+
 	if(needUpdate) {
 		QSqlQuery insertQuery(database);
 		insertQuery.prepare(QStringLiteral("INSERT OR REPLACE INTO DataIndex (Type, Key, File) VALUES(?, ?, ?)"));
 		insertQuery.addBindValue(key.first);
 		insertQuery.addBindValue(key.second);
 		insertQuery.addBindValue(tableDir.relativeFilePath(QFileInfo(file->fileName()).completeBaseName()));
-		EXEC_QUERY(insertQuery);
+		if(!insertQuery.exec()) {
+			emit requestFailed(id, insertQuery.lastError().text());
+			database.rollback();
+			file->remove();
+			return;
+		}
+	}
+
+	if(!logChange(id, key, false) || !commitTransaction(id)) {
+		database.rollback();
+		if(needUpdate)
+			file->remove();
+		return;
 	}
 
 	emit requestCompleted(id, QJsonValue::Undefined);
@@ -252,21 +432,31 @@ void SqlLocalStore::remove(quint64 id, const ObjectKey &key, const QByteArray &)
 	EXEC_QUERY(loadQuery);
 
 	if(loadQuery.first()) {
-		auto fileName = tableDir.absoluteFilePath(loadQuery.value(0).toString() + QStringLiteral(".dat"));
-		if(!QFile::remove(fileName)) {
-			emit requestFailed(id, QStringLiteral("Failed to delete file %1").arg(fileName));
+		//remove the key from the database, together with the change log entry
+		if(!beginTransaction(id))
 			return;
-		}
 
 		QSqlQuery removeQuery(database);
 		removeQuery.prepare(QStringLiteral("DELETE FROM DataIndex WHERE Type = ? AND Key = ?"));
 		removeQuery.addBindValue(key.first);
 		removeQuery.addBindValue(key.second);
-		EXEC_QUERY(removeQuery);
+		EXEC_TRANSACTION_QUERY(removeQuery);
+
+		if(!logChange(id, key, true) || !commitTransaction(id)) {
+			database.rollback();
+			return;
+		}
+
+		//the file is not referenced anymore, so failing to delete it only wastes space
+		auto fileName = tableDir.absoluteFilePath(loadQuery.value(0).toString() + QStringLiteral(".dat"));
+		if(!QFile::remove(fileName)) {
+			qCWarning(LOG) << "Failed to delete file" << fileName
+						   << "of removed dataset";
+		}
 
-		emit requestCompleted(id, true);
+		emit requestResultReady(id, true);
 	} else
-		emit requestCompleted(id, false);
+		emit requestResultReady(id, false);
 }
 
 void SqlLocalStore::search(quint64 id, const QByteArray &typeName, const QString &searchQuery)
@@ -285,6 +475,7 @@ void SqlLocalStore::search(quint64 id, const QByteArray &typeName, const QString
 
 	QJsonArray array;
 	while(findQuery.next()) {
+		CHECK_CANCELED(array.size());
 		QFile file(tableDir.absoluteFilePath(findQuery.value(0).toString() + QStringLiteral(".dat")));
 		file.open(QIODevice::ReadOnly);
 		auto doc = QJsonDocument::fromBinaryData(file.readAll());
@@ -302,6 +493,33 @@ void SqlLocalStore::search(quint64 id, const QByteArray &typeName, const QString
 	emit requestCompleted(id, array);
 }
 
+void SqlLocalStore::changesSince(quint64 id, const QByteArray &typeName, quint64 sequence)
+{
+	QSqlQuery horizonQuery(database);
+	horizonQuery.prepare(QStringLiteral("SELECT Seq FROM ChangeLogHorizon"));
+	EXEC_QUERY(horizonQuery);
+
+	QSqlQuery changesQuery(database);
+	changesQuery.prepare(QStringLiteral("SELECT Key, Deleted FROM ChangeLog WHERE Type = ? AND Seq > ? ORDER BY Seq"));
+	changesQuery.addBindValue(typeName);
+	changesQuery.addBindValue(sequence);
+	EXEC_QUERY(changesQuery);
+
+	ChangeSet changeSet;
+	changeSet.sequence = currentSequence();
+	//a sequence from the future means the database was replaced
+	changeSet.complete = sequence <= changeSet.sequence &&
+						 (!horizonQuery.first() || sequence >= horizonQuery.value(0).toULongLong());
+	while(changesQuery.next()) {
+		if(changesQuery.value(1).toBool())
+			changeSet.deleted.append(changesQuery.value(0).toString());
+		else
+			changeSet.changed.append(changesQuery.value(0).toString());
+	}
+
+	emit requestResultReady(id, QVariant::fromValue(changeSet));
+}
+
 QDir SqlLocalStore::typeDirectory(quint64 id, const QByteArray &typeName)
 {
 	auto tName = QString::fromUtf8("store/_" + QByteArray(typeName).toHex());
@@ -319,3 +537,88 @@ bool SqlLocalStore::testTableExists(const QString &tableName) const
 {
 	return database.tables().contains(tableName);
 }
+
+bool SqlLocalStore::beginTransaction(quint64 id)
+{
+	if(!database.transaction()) {
+		emit requestFailed(id, QStringLiteral("Failed to start database transaction with error: %1")
+						   .arg(database.lastError().text()));
+		return false;
+	} else
+		return true;
+}
+
+bool SqlLocalStore::commitTransaction(quint64 id)
+{
+	if(!database.commit()) {
+		emit requestFailed(id, QStringLiteral("Failed to commit transaction with error: %1")
+						   .arg(database.lastError().text()));
+		return false;
+	} else
+		return true;
+}
+
+bool SqlLocalStore::logChange(quint64 id, const ObjectKey &key, bool deleted)
+{
+	//replacing the entry of the key moves it to the end of the log with a new sequence number
+	QSqlQuery logQuery(database);
+	logQuery.prepare(QStringLiteral("INSERT OR REPLACE INTO ChangeLog (Type, Key, Deleted) VALUES(?, ?, ?)"));
+	logQuery.addBindValue(key.first);
+	logQuery.addBindValue(key.second);
+	logQuery.addBindValue(deleted);
+	if(!logQuery.exec()) {
+		emit requestFailed(id, logQuery.lastError().text());
+		return false;
+	}
+
+	if(!deleted)
+		return true;
+
+	//saved keys are bounded by the data itself, only the entries of removed ones need to be trimmed
+	static const int MaxDeletedChanges = 10000;
+	QSqlQuery trimSeqQuery(database);
+	trimSeqQuery.prepare(QStringLiteral("SELECT Seq FROM ChangeLog WHERE Deleted = 1 ORDER BY Seq DESC LIMIT 1 OFFSET ?"));
+	trimSeqQuery.addBindValue(MaxDeletedChanges);
+	if(!trimSeqQuery.exec()) {
+		emit requestFailed(id, trimSeqQuery.lastError().text());
+		return false;
+	}
+	if(!trimSeqQuery.first())
+		return true;
+	auto horizon = trimSeqQuery.value(0).toULongLong();
+
+	QSqlQuery trimQuery(database);
+	trimQuery.prepare(QStringLiteral("DELETE FROM ChangeLog WHERE Deleted = 1 AND Seq <= ?"));
+	trimQuery.addBindValue(horizon);
+	if(!trimQuery.exec()) {
+		emit requestFailed(id, trimQuery.lastError().text());
+		return false;
+	}
+
+	QSqlQuery horizonQuery(database);
+	horizonQuery.prepare(QStringLiteral("UPDATE ChangeLogHorizon SET Seq = ?"));
+	horizonQuery.addBindValue(horizon);
+	if(!horizonQuery.exec()) {
+		emit requestFailed(id, horizonQuery.lastError().text());
+		return false;
+	}
+
+	return true;
+}
+
+quint64 SqlLocalStore::currentSequence() const
+{
+	//sqlite keeps the highest sequence ever used, even if the entry has been deleted since
+	QSqlQuery seqQuery(database);
+	seqQuery.prepare(QStringLiteral("SELECT seq FROM sqlite_sequence WHERE name = 'ChangeLog'"));
+	if(!seqQuery.exec()) {
+		qCCritical(LOG) << "Failed to read the change log sequence with error:"
+						<< seqQuery.lastError().text();
+		return 0;
+	}
+
+	if(seqQuery.first())
+		return seqQuery.value(0).toULongLong();
+	else
+		return 0;
+}
@@ -23,21 +23,29 @@ public:
 
 	QList<ObjectKey> loadAllKeys() override;
 	void resetStore() override;
+	LocalStore *createShard(QObject *parent) override;
 
 public Q_SLOTS:
 	void count(quint64 id, const QByteArray &typeName) override;
 	void keys(quint64 id, const QByteArray &typeName) override;
 	void loadAll(quint64 id, const QByteArray &typeName) override;
+	void loadAllProjected(quint64 id, const QByteArray &typeName, const QStringList &properties) override;
 	void load(quint64 id, const ObjectKey &key, const QByteArray &keyProperty) override;
+	void loadMany(quint64 id, const QByteArray &typeName, const QStringList &keys, const QByteArray &keyProperty) override;
 	void save(quint64 id, const ObjectKey &key, const QJsonObject &object, const QByteArray &keyProperty) override;
 	void remove(quint64 id, const ObjectKey &key, const QByteArray &keyProperty) override;
 	void search(quint64 id, const QByteArray &typeName, const QString &searchQuery) override;
+	void changesSince(quint64 id, const QByteArray &typeName, quint64 sequence) override;
 
 private:
 	Defaults *defaults;
 	QSqlDatabase database;
 
 	QDir typeDirectory(quint64 id, const QByteArray &typeName);
+	bool beginTransaction(quint64 id);
+	bool commitTransaction(quint64 id);
+	bool logChange(quint64 id, const ObjectKey &key, bool deleted);
+	quint64 currentSequence() const;
 	bool testTableExists(const QString &typeDirectory) const;
 };
 
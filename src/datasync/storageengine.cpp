@@ -1,15 +1,70 @@
 #include "exceptions.h"
 #include "storageengine_p.h"
+#include "localstore_p.h"
+#include "tasknotifier_p.h"
 #include "defaults.h"
+#include "changeset.h"
 
 #include <QtCore/QThread>
 #include <QtCore/QDateTime>
+#include <QtCore/QMetaEnum>
+#include <QtCore/QRunnable>
+#include <QtCore/QSet>
+
+#include <algorithm>
 
 using namespace QtDataSync;
 
 #define LOG defaults->loggingCategory()
 
-StorageEngine::StorageEngine(Defaults *defaults, QJsonSerializer *serializer, LocalStore *localStore, StateHolder *stateHolder, RemoteConnector *remoteConnector, DataMerger *dataMerger, Encryptor *encryptor) :
+class StorageEngine::ConvertRunnable : public QRunnable
+{
+public:
+	ConvertRunnable(const QJsonSerializer *serializer,
+					const QSharedPointer<TaskRegistry> &registry,
+					const Waiter &waiter,
+					int convertMetaTypeId,
+					const QJsonValue &result,
+					bool projected);
+
+	void run() override;
+
+private:
+	const QJsonSerializer *serializer;
+	QSharedPointer<TaskRegistry> registry;
+	Waiter waiter;
+	int convertMetaTypeId;
+	QJsonValue result;
+	bool projected;
+};
+
+class StorageEngine::ConvertManyRunnable : public QRunnable
+{
+public:
+	struct Result {
+		QMutex mutex;
+		QSharedPointer<TaskRegistry> registry;
+		Waiter waiter;
+		QVariantHash data;
+		int pending;
+		bool failed;
+	};
+
+	ConvertManyRunnable(const QJsonSerializer *serializer,
+						const QSharedPointer<Result> &result,
+						int convertMetaTypeId,
+						const QJsonObject &chunk);
+
+	void run() override;
+
+private:
+	const QJsonSerializer *serializer;
+	QSharedPointer<Result> result;
+	int convertMetaTypeId;
+	QJsonObject chunk;
+};
+
+StorageEngine::StorageEngine(Defaults *defaults, QJsonSerializer *serializer, LocalStore *localStore, StateHolder *stateHolder, RemoteConnector *remoteConnector, DataMerger *dataMerger, Encryptor *encryptor, int shardCount) :
 	QObject(),
 	defaults(defaults),
 	serializer(serializer),
@@ -18,8 +73,24 @@ StorageEngine::StorageEngine(Defaults *defaults, QJsonSerializer *serializer, Lo
 	remoteConnector(remoteConnector),
 	encryptor(encryptor),
 	changeController(new ChangeController(dataMerger, this)),
+	convertPool(new QThreadPool(this)),
+	registry(new TaskRegistry()),
+	shardCount(shardCount),
+	shards(),
 	requestCache(),
-	requestCounter(0),
+	activeLoads(),
+	notifyTimer(new QTimer(this)),
+	pendingNotifies(),
+	taskMutex(),
+	taskQueues(),
+	queuedSaves(),
+	queuedSyncWrites(),
+	cancelableRequests(),
+	processScheduled(false),
+	requestLimit(0),
+	requestLimitPolicy(Setup::RejectRequests),
+	snapshotsEnabled(false),
+	stats(),
 	controllerLock(QReadWriteLock::Recursive),
 	currentSyncState(SyncController::Loading),
 	currentAuthError()
@@ -31,6 +102,12 @@ StorageEngine::StorageEngine(Defaults *defaults, QJsonSerializer *serializer, Lo
 	remoteConnector->setParent(this);
 	if(encryptor)
 		encryptor->setParent(this);
+
+	//changes are collected for a short time, to notify about them in batches
+	notifyTimer->setSingleShot(true);
+	notifyTimer->setInterval(25);
+	connect(notifyTimer, &QTimer::timeout,
+			this, &StorageEngine::flushNotifications);
 }
 
 bool StorageEngine::isSyncEnabled() const
@@ -50,49 +127,120 @@ QString StorageEngine::authenticationError() const
 	return currentAuthError;
 }
 
-void StorageEngine::beginTask(QFutureInterface<QVariant> futureInterface, QThread *targetThread, StorageEngine::TaskType taskType, int metaTypeId, const QVariant &value)
+QJsonObject StorageEngine::serializeValue(int metaTypeId, QVariant value) const
 {
-	try {
-		auto flags = QMetaType::typeFlags(metaTypeId);
-		auto metaObject = QMetaType::metaObjectForType(metaTypeId);
-		if((!flags.testFlag(QMetaType::PointerToQObject) &&
-			!flags.testFlag(QMetaType::IsGadget)) ||
-		   !metaObject)
-			throw DataSyncException("You can only store QObjects or Q_GADGETs with QtDataSync!");
+	if(!value.convert(metaTypeId)) {
+		throw QJsonSerializationException(QStringLiteral("Failed to convert value to %1")
+										  .arg(QString::fromUtf8(QMetaType::typeName(metaTypeId)))
+										  .toUtf8());
+	}
 
-		auto userProp = metaObject->userProperty();
-		if(!userProp.isValid())
-			throw DataSyncException("To store a datatype, it requires a user property");
+	return serializer->serialize(value).toObject();
+}
 
-		switch (taskType) {
-		case Count:
-			count(futureInterface, targetThread, metaTypeId);
-			break;
-		case Keys:
-			keys(futureInterface, targetThread, metaTypeId);
-			break;
-		case LoadAll:
-			loadAll(futureInterface, targetThread, metaTypeId, value.toInt());
-			break;
-		case Load:
-			load(futureInterface, targetThread, metaTypeId, userProp.name(), value.toString());
-			break;
-		case Save:
-			save(futureInterface, targetThread, metaTypeId, userProp.name(), value);
-			break;
-		case Remove:
-			remove(futureInterface, targetThread, metaTypeId, userProp.name(), value.toString());
-			break;
-		case Search:
-			search(futureInterface, targetThread, metaTypeId, value.value<QPair<int, QString>>());
-			break;
-		default:
-			break;
+QVariant StorageEngine::deserializeValue(int metaTypeId, const QJsonObject &data) const
+{
+	return serializer->deserialize(data, metaTypeId);
+}
+
+EngineStatistics StorageEngine::statistics() const
+{
+	QMutexLocker _(&taskMutex);
+	auto result = stats;
+	result.queuedRequests = queuedTasks(false) + delayedTasks.size();
+	return result;
+}
+
+QDir StorageEngine::storageDir() const
+{
+	return defaults->storageDir();
+}
+
+const QLoggingCategory &StorageEngine::loggingCategory() const
+{
+	return defaults->loggingCategory();
+}
+
+bool StorageEngine::cacheSnapshots() const
+{
+	return snapshotsEnabled;
+}
+
+void StorageEngine::setRequestLimit(int limit, Setup::RequestLimitPolicy policy)
+{
+	QMutexLocker _(&taskMutex);
+	requestLimit = qMax(limit, 0);
+	requestLimitPolicy = policy;
+	admitDelayedTasks();
+}
+
+void StorageEngine::setCacheSnapshots(bool cacheSnapshots)
+{
+	//only set before the engine is started, so it can be read from any thread
+	snapshotsEnabled = cacheSnapshots;
+}
+
+QSharedPointer<TaskRegistry> StorageEngine::taskRegistry() const
+{
+	return registry;
+}
+
+void StorageEngine::submitTask(const Waiter &waiter, StorageEngine::TaskType taskType, int metaTypeId, const QVariant &value, RequestLane lane, quint64 origin)
+{
+	QSharedPointer<TaskInfo> task(new TaskInfo());
+	//writes always use the interactive lane, so they can never overtake each other (see nextTask for sync writes)
+	task->lane = (taskType == Save || taskType == Remove) ? Interactive : lane;
+	task->futureInterface = waiter.futureInterface;
+	task->targetThread = waiter.targetThread;
+	task->taskId = waiter.taskId;
+	task->taskType = taskType;
+	task->metaTypeId = metaTypeId;
+	task->value = value;
+	task->origin = origin;
+	task->timer.start();
+	switch (taskType) {
+	case Load:
+	case Remove:
+		task->key = value.toString();
+		break;
+	case Save:
+	{
+		auto metaObject = QMetaType::metaObjectForType(metaTypeId);
+		if(metaObject && metaObject->userProperty().isValid()) {
+			auto keyProperty = QString::fromUtf8(metaObject->userProperty().name());
+			task->key = value.toJsonObject()[keyProperty].toVariant().toString();
 		}
-	} catch(QException &e) {
-		futureInterface.reportException(e);
-		futureInterface.reportFinished();
+		break;
+	}
+	default:
+		break;
+	}
+
+	QMutexLocker _(&taskMutex);
+	if(coalesceTask(task)) {
+		stats.coalescedRequests++;
+		return;
 	}
+
+	//once requests are delayed, all following ones must wait behind them to keep their order
+	auto overloaded = requestLimit != 0 &&
+					  (!delayedTasks.isEmpty() || queuedTasks(true) >= requestLimit);
+	if(overloaded && requestLimitPolicy != Setup::DelayRequests) {
+		stats.rejectedRequests++;
+		task->futureInterface.reportException(EngineOverloadedException(requestLimit));
+		registry->finish(task->futureInterface, task->taskId);
+		return;
+	}
+
+	if(taskType == Save && !task->key.isNull())
+		queuedSaves[metaTypeId].insert(task->key, task);
+	if(overloaded) {
+		//the task is reported as paused until it has been admitted to the queue
+		stats.delayedRequests++;
+		task->futureInterface.setPaused(true);
+		delayedTasks.enqueue(task);
+	} else
+		enqueueTask(task);
 }
 
 void StorageEngine::triggerSync()
@@ -116,13 +264,42 @@ void StorageEngine::initialize()
 {
 	qsrand(QDateTime::currentMSecsSinceEpoch());
 
-	//localStore
-	connect(localStore, &LocalStore::requestCompleted,
-			this, &StorageEngine::requestCompleted,
-			Qt::QueuedConnection);
-	connect(localStore, &LocalStore::requestFailed,
-			this, &StorageEngine::requestFailed,
-			Qt::QueuedConnection);
+	//localStore (always initialized first, so shards find an existing schema)
+	localStore->initialize(defaults);
+	if(shardCount > 1) {
+		for(auto i = 0; i < shardCount; i++) {
+			auto shardStore = localStore->createShard();
+			if(!shardStore) {
+				qCWarning(LOG) << "Local store does not support sharding. Using a single store instead of"
+							   << shardCount
+							   << "shards";
+				break;
+			}
+			shards.append(new StorageShard(shardStore, true, this));
+		}
+	}
+	if(shards.size() <= 1) {
+		foreach(auto shard, shards) {
+			delete shard->store();
+			delete shard;
+		}
+		shards = {new StorageShard(localStore, false, this)};
+	}
+
+	foreach(auto shard, shards) {
+		shard->store()->d->cancelCheck = [this](quint64 id) {
+			return isRequestCanceled(id);
+		};
+		//auto connections: stores on the engine thread complete their requests directly
+		connect(shard->store(), &LocalStore::requestCompleted,
+				this, &StorageEngine::requestCompleted);
+		connect(shard->store(), &LocalStore::requestResultReady,
+				this, &StorageEngine::requestResultReady);
+		connect(shard->store(), &LocalStore::requestFailed,
+				this, &StorageEngine::requestFailed);
+		if(shard->hasOwnThread())
+			shard->initialize(defaults);
+	}
 
 	//changeController
 	connect(changeController, &ChangeController::loadLocalStatus,
@@ -135,12 +312,12 @@ void StorageEngine::initialize()
 			changeController, &ChangeController::setRemoteStatus);
 	connect(remoteConnector, &RemoteConnector::remoteDataChanged,
 			changeController, &ChangeController::updateRemoteStatus);
+	//both only hand the operation on (the remote connector reports back queued, local operations are
+	//enqueued as tasks), so they can be called directly without reentering the change controller
 	connect(changeController, &ChangeController::beginRemoteOperation,
-			this, &StorageEngine::beginRemoteOperation,
-			Qt::QueuedConnection);
+			this, &StorageEngine::beginRemoteOperation);
 	connect(changeController, &ChangeController::beginLocalOperation,
-			this, &StorageEngine::beginLocalOperation,
-			Qt::QueuedConnection);
+			this, &StorageEngine::beginLocalOperation);
 
 	//remoteConnector
 	connect(remoteConnector, &RemoteConnector::operationDone,
@@ -159,7 +336,6 @@ void StorageEngine::initialize()
 			this, &StorageEngine::performLocalReset,
 			Qt::DirectConnection);//explicitly direct connected -> blocking
 
-	localStore->initialize(defaults);
 	stateHolder->initialize(defaults);
 	changeController->initialize(defaults);
 	if(encryptor)
@@ -169,57 +345,153 @@ void StorageEngine::initialize()
 
 void StorageEngine::finalize()
 {
+	taskMutex.lock();
+	requestLimit = 0;
+	queuedSaves.clear();
+	queuedSyncWrites.clear();
+	for(auto lane = 0; lane < LaneCount; lane++) {
+		while(!taskQueues[lane].isEmpty()) {
+			auto task = taskQueues[lane].dequeue();
+			if(task->isChangeControllerTask)
+				continue;
+			task->waiters.prepend({task->futureInterface, task->targetThread, task->taskId});
+			foreach(auto waiter, task->waiters) {
+				waiter.futureInterface.reportCanceled();
+				registry->finish(waiter.futureInterface, waiter.taskId);
+			}
+		}
+	}
+	while(!delayedTasks.isEmpty()) {
+		auto task = delayedTasks.dequeue();
+		task->waiters.prepend({task->futureInterface, task->targetThread, task->taskId});
+		foreach(auto waiter, task->waiters) {
+			waiter.futureInterface.reportCanceled();
+			registry->finish(waiter.futureInterface, waiter.taskId);
+		}
+	}
+	taskMutex.unlock();
+
+	convertPool->waitForDone();
 	remoteConnector->finalize();
 	changeController->finalize();
 	stateHolder->finalize();
+	foreach(auto shard, shards) {
+		if(shard->hasOwnThread())
+			shard->finalize();
+	}
 	localStore->finalize();
+
+	//requests still running in the store are never completed, so their tasks are canceled instead
+	foreach(auto info, requestCache.values()) {
+		if(info.isChangeControllerRequest)
+			continue;
+		info.waiters.prepend({info.futureInterface, info.targetThread, info.taskId});
+		foreach(auto waiter, info.waiters) {
+			waiter.futureInterface.reportCanceled();
+			registry->finish(waiter.futureInterface, waiter.taskId);
+		}
+	}
+	requestCache.clear();
+	activeLoads.clear();
+	registry->clear();
 	thread()->quit();
 }
 
-void StorageEngine::requestCompleted(quint64 id, const QJsonValue &result)
+void StorageEngine::processTasks()
 {
-	auto info = requestCache.take(id);
+	QElapsedTimer sliceTimer;
+	sliceTimer.start();
 
-	if(info.isChangeControllerRequest) {
-		changeController->nextStage(true, result);
-	} else {
-		if(!result.isUndefined()) {
-			try {
-				auto obj = serializer->deserialize(result, info.convertMetaTypeId);
-				if(info.targetThread)
-					tryMoveToThread(obj, info.targetThread);
-				info.futureInterface.reportResult(obj);
-			} catch(QJsonSerializerException &e) {
-				info.futureInterface.reportException(e);
+	forever {
+		QSharedPointer<TaskInfo> task;
+		{
+			QMutexLocker _(&taskMutex);
+			if(queuedTasks(false) == 0) {
+				processScheduled = false;
+				return;
 			}
-		} else
-			info.futureInterface.reportResult(QVariant());
+			//yield to other events (like store completions) after each time slice
+			if(sliceTimer.elapsed() >= 5) {
+				QMetaObject::invokeMethod(this, "processTasks", Qt::QueuedConnection);
+				return;
+			}
+			task = nextTask();
+			if(task->taskType == Save) {
+				auto it = queuedSaves.find(task->metaTypeId);
+				if(it != queuedSaves.end() && it->value(task->key) == task)
+					it->remove(task->key);
+			}
+			admitDelayedTasks();
+		}
 
-		info.futureInterface.reportFinished();
+		if(task->isChangeControllerTask)
+			startLocalOperation(task->operation);
+		else if(dropCanceled(*task)) {
+			QMutexLocker _(&taskMutex);
+			stats.canceledRequests++;
+		} else
+			beginTask(*task);
 	}
+}
 
-	if(info.isDeleteAction && !result.toBool())
-		return;
+void StorageEngine::requestCompleted(quint64 id, const QJsonValue &result)
+{
+	auto info = takeRequest(id);
+	if(info.isChangeControllerRequest)
+		changeController->nextStage(true, result);
+	else {
+		releaseRequest(id, info);
+		completeRequest(info, result);
+	}
+	finishChange(info, result.toBool());
+}
 
-	if(info.changeAction) {
-		stateHolder->markLocalChanged(info.changeKey, info.changeState);
-		changeController->updateLocalStatus(info.changeKey, info.changeState);
+void StorageEngine::requestResultReady(quint64 id, const QVariant &result)
+{
+	auto info = takeRequest(id);
+	if(info.isChangeControllerRequest)
+		changeController->nextStage(true, QJsonValue::fromVariant(result));
+	else {
+		releaseRequest(id, info);
+		completeRequest(info, result);
 	}
+	finishChange(info, result.toBool());
+}
 
-	if(!info.notifyKey.first.isNull())
-		emit notifyChanged(QMetaType::type(info.notifyKey.first), info.notifyKey.second, info.isDeleteAction);
+void StorageEngine::flushNotifications()
+{
+	notifyTimer->stop();
+	auto notifies = pendingNotifies;
+	pendingNotifies.clear();
+
+	for(auto it = notifies.constBegin(); it != notifies.constEnd(); it++) {
+		for(auto jt = it->constBegin(); jt != it->constEnd(); jt++) {
+			QStringList changed;
+			QStringList deleted;
+			QJsonObject changedData;
+			for(auto kt = jt->constBegin(); kt != jt->constEnd(); kt++) {
+				if(kt->isNull())
+					deleted.append(kt.key());
+				else {
+					changed.append(kt.key());
+					changedData.insert(kt.key(), *kt);
+				}
+			}
+			emit notifyChangedBatch(it.key(), changed, deleted, changedData, jt.key());
+		}
+	}
 }
 
 void StorageEngine::requestFailed(quint64 id, const QString &errorString)
 {
-	auto info = requestCache.take(id);
+	auto info = takeRequest(id);
 	if(info.isChangeControllerRequest) {
 		qCCritical(LOG) << "Local operation failed with error:"
 						<< errorString;
 		changeController->nextStage(false);
 	} else {
-		info.futureInterface.reportException(DataSyncException(errorString));
-		info.futureInterface.reportFinished();
+		releaseRequest(id, info);
+		failRequest(info, DataSyncException(errorString));
 	}
 }
 
@@ -259,6 +531,10 @@ void StorageEngine::loadLocalStatus()
 
 void StorageEngine::updateSyncState(SyncController::SyncState state)
 {
+	//a finished sync ends a batch
+	if(state != SyncController::Loading && state != SyncController::Syncing)
+		flushNotifications();
+
 	QWriteLocker _(&controllerLock);
 	if(state != currentSyncState) {
 		currentSyncState = state;
@@ -297,6 +573,25 @@ void StorageEngine::beginRemoteOperation(const ChangeController::ChangeOperation
 }
 
 void StorageEngine::beginLocalOperation(const ChangeController::ChangeOperation &operation)
+{
+	QSharedPointer<TaskInfo> task(new TaskInfo());
+	task->lane = Sync;
+	task->timer.start();
+	task->isChangeControllerTask = true;
+	task->operation = operation;
+
+	QMutexLocker _(&taskMutex);
+	if(isSyncWrite(*task)) {
+		queuedSyncWrites[operation.key]++;
+		//saves queued before this write must not take the data of ones submitted after it
+		auto it = queuedSaves.find(QMetaType::type(operation.key.first));
+		if(it != queuedSaves.end())
+			it->remove(operation.key.second);
+	}
+	enqueueTask(task);
+}
+
+void StorageEngine::startLocalOperation(const ChangeController::ChangeOperation &operation)
 {
 	auto metaTypeId = QMetaType::type(operation.key.first);
 	auto metaObject = QMetaType::metaObjectForType(metaTypeId);
@@ -307,23 +602,22 @@ void StorageEngine::beginLocalOperation(const ChangeController::ChangeOperation
 		return;
 	}
 
-	auto id = requestCounter++;
 	RequestInfo info(true);
 
 	auto userProperty = metaObject->userProperty();
 	switch (operation.operation) {
 	case ChangeController::Load:
-		requestCache.insert(id, info);
-		localStore->load(id, operation.key, userProperty.name());
+		emit shardFor(operation.key.first)->load(requestCache.insert(info), operation.key, userProperty.name());
 		break;
 	case ChangeController::Save:
 		info.notifyKey = operation.key;
 		info.isDeleteAction = false;
+		info.notifyData = operation.writeObject;
 		info.changeAction = true;
 		info.changeKey = operation.key;
 		info.changeState = StateHolder::Unchanged;
-		requestCache.insert(id, info);
-		localStore->save(id, operation.key, operation.writeObject, userProperty.name());
+		activeLoads.remove(operation.key);
+		emit shardFor(operation.key.first)->save(requestCache.insert(info), operation.key, operation.writeObject, userProperty.name());
 		break;
 	case ChangeController::Remove:
 		info.notifyKey = operation.key;
@@ -331,8 +625,8 @@ void StorageEngine::beginLocalOperation(const ChangeController::ChangeOperation
 		info.changeAction = true;
 		info.changeKey = operation.key;
 		info.changeState = StateHolder::Unchanged;
-		requestCache.insert(id, info);
-		localStore->remove(id, operation.key, userProperty.name());
+		activeLoads.remove(operation.key);
+		emit shardFor(operation.key.first)->remove(requestCache.insert(info), operation.key, userProperty.name());
 		break;
 	case ChangeController::MarkUnchanged:
 		stateHolder->markLocalChanged(operation.key, StateHolder::Unchanged);
@@ -345,10 +639,14 @@ void StorageEngine::beginLocalOperation(const ChangeController::ChangeOperation
 
 void StorageEngine::performLocalReset(bool clearStore)
 {
+	drainShards();
+	activeLoads.clear();
 	if(clearStore) {
 		localStore->resetStore();
 		stateHolder->clearAllChanges();
 		changeController->setInitialLocalStatus({}, false);
+		notifyTimer->stop();
+		pendingNotifies.clear();
 		emit notifyResetted();
 	} else {
 		auto state = stateHolder->resetAllChanges(localStore->loadAllKeys());
@@ -356,78 +654,540 @@ void StorageEngine::performLocalReset(bool clearStore)
 	}
 }
 
-void StorageEngine::count(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int metaTypeId)
+int StorageEngine::queuedTasks(bool requestsOnly) const
 {
-	auto id = requestCounter++;
-	requestCache.insert(id, {futureInterface, targetThread, QMetaType::Int});
-	localStore->count(id, QMetaType::typeName(metaTypeId));
+	auto count = 0;
+	for(auto lane = 0; lane < LaneCount; lane++) {
+		if(!requestsOnly || lane != Sync)
+			count += taskQueues[lane].size();
+	}
+	return count;
 }
 
-void StorageEngine::keys(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int metaTypeId)
+bool StorageEngine::coalesceTask(const QSharedPointer<TaskInfo> &task)
 {
-	auto id = requestCounter++;
-	requestCache.insert(id, {futureInterface, targetThread, QMetaType::QStringList});
-	localStore->keys(id, QMetaType::typeName(metaTypeId));
+	switch (task->taskType) {
+	case Save:
+	{
+		if(task->key.isNull())
+			return false;
+		auto queued = queuedSaves.value(task->metaTypeId).value(task->key);
+		if(!queued)
+			return false;
+
+		//the queued save has not reached the store yet, so it simply takes the newer data
+		queued->value = task->value;
+		queued->origin = task->origin;
+		queued->waiters.append({task->futureInterface, task->targetThread, task->taskId});
+		return true;
+	}
+	case Load:
+	case Remove:
+	{
+		//saves queued before this request must not be moved behind it
+		auto it = queuedSaves.find(task->metaTypeId);
+		if(it != queuedSaves.end())
+			it->remove(task->key);
+		return false;
+	}
+	default:
+		queuedSaves.remove(task->metaTypeId);
+		return false;
+	}
 }
 
-void StorageEngine::loadAll(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int dataMetaTypeId, int listMetaTypeId)
+void StorageEngine::admitDelayedTasks()
 {
-	auto id = requestCounter++;
-	requestCache.insert(id, {futureInterface, targetThread, listMetaTypeId});
-	localStore->loadAll(id, QMetaType::typeName(dataMetaTypeId));
+	while(!delayedTasks.isEmpty() &&
+		  (requestLimit == 0 || queuedTasks(true) < requestLimit)) {
+		auto task = delayedTasks.dequeue();
+		task->futureInterface.setPaused(false);
+		enqueueTask(task);
+	}
 }
 
-void StorageEngine::load(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int metaTypeId, const QByteArray &keyProperty, const QString &value)
+void StorageEngine::enqueueTask(const QSharedPointer<TaskInfo> &task)
 {
-	auto id = requestCounter++;
-	requestCache.insert(id, {futureInterface, targetThread, metaTypeId});
-	localStore->load(id, {QMetaType::typeName(metaTypeId), value}, keyProperty);
+	taskQueues[task->lane].enqueue(task);
+	stats.peakQueuedRequests = qMax(stats.peakQueuedRequests, queuedTasks(false));
+	if(!processScheduled) {
+		processScheduled = true;
+		QMetaObject::invokeMethod(this, "processTasks", Qt::QueuedConnection);
+	}
 }
 
-void StorageEngine::save(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int metaTypeId, const QByteArray &keyProperty, QVariant value)
+QSharedPointer<StorageEngine::TaskInfo> StorageEngine::nextTask()
 {
-	if(!value.convert(metaTypeId)) {
-		throw QJsonSerializationException(QStringLiteral("Failed to convert value to %1")
-										  .arg(QString::fromUtf8(QMetaType::typeName(metaTypeId)))
-										  .toUtf8());
+	//maximum time in ms the head of a lane may wait before it is served regardless of priority
+	static const qint64 starvationLimits[LaneCount] = {0, 100, 500};
+
+	auto lane = 0;
+	while(taskQueues[lane].isEmpty())
+		lane++;
+
+	//once a lower lane starves, the oldest task of all lanes is served
+	for(auto i = lane + 1; i < LaneCount; i++) {
+		if(!taskQueues[i].isEmpty() &&
+		   taskQueues[i].head()->timer.elapsed() >= starvationLimits[i]) {
+			for(auto j = 0; j < LaneCount; j++) {
+				if(!taskQueues[j].isEmpty() &&
+				   taskQueues[j].head()->timer < taskQueues[lane].head()->timer)
+					lane = j;
+			}
+			break;
+		}
+	}
+
+	//user writes must not overtake change controller operations on the same dataset that were queued before them
+	QSharedPointer<TaskInfo> task;
+	auto head = taskQueues[lane].head();
+	if(!head->isChangeControllerTask &&
+	   (head->taskType == Save || head->taskType == Remove)) {
+		ObjectKey key = {QMetaType::typeName(head->metaTypeId), head->key};
+		if(queuedSyncWrites.contains(key)) {
+			auto &syncQueue = taskQueues[Sync];
+			for(auto i = 0; i < syncQueue.size(); i++) {
+				if(syncQueue[i]->isChangeControllerTask &&
+				   syncQueue[i]->operation.key == key &&
+				   syncQueue[i]->timer < head->timer) {
+					lane = Sync;
+					task = syncQueue.takeAt(i);
+					break;
+				}
+			}
+		}
+	}
+	if(!task)
+		task = taskQueues[lane].dequeue();
+
+	if(isSyncWrite(*task)) {
+		auto it = queuedSyncWrites.find(task->operation.key);
+		if(--(*it) == 0)
+			queuedSyncWrites.erase(it);
+	}
+
+	auto laneName = QByteArray(QMetaEnum::fromType<RequestLane>().valueToKey(lane));
+	addToHistogram(stats.laneWaitHistograms[laneName], task->timer.nsecsElapsed() / 1000);
+	return task;
+}
+
+bool StorageEngine::isSyncWrite(const TaskInfo &task)
+{
+	return task.isChangeControllerTask &&
+			(task.operation.operation == ChangeController::Save ||
+			 task.operation.operation == ChangeController::Remove);
+}
+
+void StorageEngine::beginTask(const TaskInfo &task)
+{
+	try {
+		auto flags = QMetaType::typeFlags(task.metaTypeId);
+		auto metaObject = QMetaType::metaObjectForType(task.metaTypeId);
+		if((!flags.testFlag(QMetaType::PointerToQObject) &&
+			!flags.testFlag(QMetaType::IsGadget)) ||
+		   !metaObject)
+			throw DataSyncException("You can only store QObjects or Q_GADGETs with QtDataSync!");
+
+		auto userProp = metaObject->userProperty();
+		if(!userProp.isValid())
+			throw DataSyncException("To store a datatype, it requires a user property");
+
+		switch (task.taskType) {
+		case Count:
+			count(task);
+			break;
+		case Keys:
+			keys(task);
+			break;
+		case LoadAll:
+			loadAll(task);
+			break;
+		case LoadAllProjected:
+			loadAllProjected(task, metaObject);
+			break;
+		case Load:
+			load(task, userProp.name());
+			break;
+		case LoadMany:
+			loadMany(task, userProp.name());
+			break;
+		case Save:
+			save(task, userProp.name());
+			break;
+		case Remove:
+			remove(task, userProp.name());
+			break;
+		case Search:
+			search(task);
+			break;
+		case ChangesSince:
+			changesSince(task);
+			break;
+		default:
+			Q_UNREACHABLE();
+			break;
+		}
+	} catch(QException &e) {
+		failRequest(RequestInfo(task), e);
+	}
+}
+
+bool StorageEngine::dropCanceled(TaskInfo &task)
+{
+	auto waiters = task.waiters;
+	waiters.prepend({task.futureInterface, task.targetThread, task.taskId});
+
+	QList<Waiter> remaining;
+	foreach(auto waiter, waiters) {
+		if(waiter.futureInterface.isCanceled())
+			registry->finish(waiter.futureInterface, waiter.taskId);
+		else
+			remaining.append(waiter);
+	}
+
+	if(remaining.isEmpty())
+		return true;
+	else {
+		auto first = remaining.takeFirst();
+		task.futureInterface = first.futureInterface;
+		task.targetThread = first.targetThread;
+		task.taskId = first.taskId;
+		task.waiters = remaining;
+		return false;
+	}
+}
+
+bool StorageEngine::isRequestCanceled(quint64 id) const
+{
+	QMutexLocker _(&taskMutex);
+	auto it = cancelableRequests.constFind(id);
+	if(it == cancelableRequests.constEnd())
+		return false;
+
+	foreach(auto futureInterface, *it) {
+		if(!futureInterface.isCanceled())
+			return false;
+	}
+	return true;
+}
+
+StorageEngine::RequestInfo StorageEngine::takeRequest(quint64 id)
+{
+	auto info = requestCache.take(id);
+	if(!info.loadKey.first.isNull() && activeLoads.value(info.loadKey) == id)
+		activeLoads.remove(info.loadKey);
+	return info;
+}
+
+void StorageEngine::finishChange(const RequestInfo &info, bool removed)
+{
+	if(info.isDeleteAction && !removed)
+		return;
+
+	if(info.changeAction) {
+		stateHolder->markLocalChanged(info.changeKey, info.changeState);
+		changeController->updateLocalStatus(info.changeKey, info.changeState);
+	}
+
+	if(!info.notifyKey.first.isNull())
+		notifyChange(QMetaType::type(info.notifyKey.first), info.notifyKey.second, info.isDeleteAction, info.notifyData, info.notifyOrigin);
+}
+
+quint64 StorageEngine::registerRequest(const RequestInfo &info)
+{
+	auto id = requestCache.insert(info);
+
+	QMutexLocker _(&taskMutex);
+	stats.activeRequests++;
+	if(!info.isChangeControllerRequest) {
+		auto &futures = cancelableRequests[id];
+		futures.append(info.futureInterface);
+		foreach(auto waiter, info.waiters)
+			futures.append(waiter.futureInterface);
+	}
+	return id;
+}
+
+void StorageEngine::count(const TaskInfo &task)
+{
+	auto id = registerRequest({task, QMetaType::Int});
+	auto typeName = QMetaType::typeName(task.metaTypeId);
+	emit shardFor(typeName)->count(id, typeName);
+}
+
+void StorageEngine::keys(const TaskInfo &task)
+{
+	auto id = registerRequest({task, QMetaType::QStringList});
+	auto typeName = QMetaType::typeName(task.metaTypeId);
+	emit shardFor(typeName)->keys(id, typeName);
+}
+
+void StorageEngine::loadAll(const TaskInfo &task)
+{
+	auto id = registerRequest({task, task.value.toInt()});
+	auto typeName = QMetaType::typeName(task.metaTypeId);
+	emit shardFor(typeName)->loadAll(id, typeName);
+}
+
+void StorageEngine::loadAllProjected(const TaskInfo &task, const QMetaObject *metaObject)
+{
+	auto properties = task.value.toStringList();
+	foreach(auto property, properties) {
+		if(metaObject->indexOfProperty(property.toUtf8().constData()) == -1) {
+			throw DataSyncException(QStringLiteral("Type %1 has no property named %2")
+									.arg(QString::fromUtf8(metaObject->className()))
+									.arg(property));
+		}
+	}
+
+	RequestInfo info(task, task.metaTypeId);
+	info.projection = properties;
+	auto id = registerRequest(info);
+	auto typeName = QMetaType::typeName(task.metaTypeId);
+	emit shardFor(typeName)->loadAllProjected(id, typeName, properties);
+}
+
+void StorageEngine::load(const TaskInfo &task, const QByteArray &keyProperty)
+{
+	ObjectKey key = {QMetaType::typeName(task.metaTypeId), task.key};
+
+	//an identical load is already running, wait for its result instead of reading again
+	auto activeIt = activeLoads.constFind(key);
+	if(activeIt != activeLoads.constEnd()) {
+		auto info = requestCache.find(*activeIt);
+		Q_ASSERT(info);
+		info->waiters.append({task.futureInterface, task.targetThread, task.taskId});
+		info->waiters.append(task.waiters);
+		QMutexLocker _(&taskMutex);
+		auto &futures = cancelableRequests[*activeIt];
+		futures.append(task.futureInterface);
+		foreach(auto waiter, task.waiters)
+			futures.append(waiter.futureInterface);
+		stats.coalescedRequests++;
+		return;
 	}
 
-	auto json = serializer->serialize(value).toObject();
-	auto id = requestCounter++;
-	RequestInfo info(futureInterface, targetThread, metaTypeId);
-	info.notifyKey = {QMetaType::typeName(metaTypeId), json[QString::fromUtf8(keyProperty)].toVariant().toString()};
+	RequestInfo info(task, task.metaTypeId);
+	info.loadKey = key;
+	auto id = registerRequest(info);
+	activeLoads.insert(key, id);
+	emit shardFor(key.first)->load(id, key, keyProperty);
+}
+
+void StorageEngine::loadMany(const TaskInfo &task, const QByteArray &keyProperty)
+{
+	RequestInfo info(task, task.metaTypeId);
+	info.loadManyKeys = task.value.toStringList();
+	info.loadManyKeyProperty = QString::fromUtf8(keyProperty);
+	auto id = registerRequest(info);
+	auto typeName = QMetaType::typeName(task.metaTypeId);
+	emit shardFor(typeName)->loadMany(id, typeName, info.loadManyKeys, keyProperty);
+}
+
+void StorageEngine::save(const TaskInfo &task, const QByteArray &keyProperty)
+{
+	RequestInfo info(task, task.metaTypeId);
+	info.notifyKey = {QMetaType::typeName(task.metaTypeId), task.key};
 	info.isDeleteAction = false;
+	info.notifyData = task.value.toJsonObject();
 	info.changeAction = true;
 	info.changeKey = info.notifyKey;
 	info.changeState = StateHolder::Changed;
-	requestCache.insert(id, info);
-	localStore->save(id, info.changeKey, json, keyProperty);
+	activeLoads.remove(info.changeKey);
+	auto id = registerRequest(info);
+	emit shardFor(info.changeKey.first)->save(id, info.changeKey, task.value.toJsonObject(), keyProperty);
 }
 
-void StorageEngine::remove(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int metaTypeId, const QByteArray &keyProperty, const QString &value)
+void StorageEngine::remove(const TaskInfo &task, const QByteArray &keyProperty)
 {
-	auto id = requestCounter++;
-	RequestInfo info(futureInterface, targetThread, QMetaType::Bool);
-	info.notifyKey = {QMetaType::typeName(metaTypeId), value};
+	RequestInfo info(task, QMetaType::Bool);
+	info.notifyKey = {QMetaType::typeName(task.metaTypeId), task.key};
 	info.isDeleteAction = true;
 	info.changeAction = true;
 	info.changeKey = info.notifyKey;
 	info.changeState = StateHolder::Deleted;
-	requestCache.insert(id, info);
-	localStore->remove(id, info.changeKey, keyProperty);
+	activeLoads.remove(info.changeKey);
+	auto id = registerRequest(info);
+	emit shardFor(info.changeKey.first)->remove(id, info.changeKey, keyProperty);
+}
+
+void StorageEngine::search(const TaskInfo &task)
+{
+	auto data = task.value.value<QPair<int, QString>>();
+	auto id = registerRequest({task, data.first});
+	auto typeName = QMetaType::typeName(task.metaTypeId);
+	emit shardFor(typeName)->search(id, typeName, data.second);
 }
 
-void StorageEngine::search(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int dataMetaTypeId, QPair<int, QString> data)
+void StorageEngine::changesSince(const TaskInfo &task)
 {
-	auto id = requestCounter++;
-	requestCache.insert(id, {futureInterface, targetThread, data.first});
-	localStore->search(id, QMetaType::typeName(dataMetaTypeId), data.second);
+	auto id = registerRequest({task, qMetaTypeId<ChangeSet>()});
+	auto typeName = QMetaType::typeName(task.metaTypeId);
+	emit shardFor(typeName)->changesSince(id, typeName, task.value.toULongLong());
 }
 
-void StorageEngine::tryMoveToThread(QVariant object, QThread *thread) const
+void StorageEngine::completeRequest(const RequestInfo &info, QJsonValue result)
 {
-	if(object.canConvert(QVariant::List) && object.convert(QVariant::List)) {
-		foreach(auto obj, object.toList())
+	//stores without their own loadMany report all datasets, pick the requested ones
+	if(info.taskType == LoadMany && result.isArray()) {
+		auto keys = QSet<QString>::fromList(info.loadManyKeys);
+		QJsonObject datasets;
+		foreach(auto value, result.toArray()) {
+			auto object = value.toObject();
+			auto key = object.value(info.loadManyKeyProperty).toVariant().toString();
+			if(keys.contains(key))
+				datasets.insert(key, object);
+		}
+		result = datasets;
+	}
+
+	//stores without their own loadAllProjected report complete datasets, remove the other properties
+	if(info.taskType == LoadAllProjected && result.isArray()) {
+		auto array = result.toArray();
+		for(auto i = 0; i < array.size(); i++) {
+			auto object = array[i].toObject();
+			QJsonObject projected;
+			foreach(auto property, info.projection) {
+				auto it = object.constFind(property);
+				if(it != object.constEnd())
+					projected.insert(property, *it);
+			}
+			if(projected.size() != object.size())
+				array[i] = projected;
+		}
+		result = array;
+	}
+
+	auto waiters = info.waiters;
+	waiters.prepend({info.futureInterface, info.targetThread, info.taskId});
+	foreach(auto waiter, waiters) {
+		if(waiter.futureInterface.isCanceled())
+			registry->finish(waiter.futureInterface, waiter.taskId);
+		else if(info.taskType == LoadMany)
+			beginConvertMany(waiter, info.convertMetaTypeId, result.toObject());
+		else if(!result.isUndefined())
+			beginConvert(waiter, info.convertMetaTypeId, result, info.taskType == LoadAllProjected);
+		else {
+			waiter.futureInterface.reportResult(QVariant());
+			registry->finish(waiter.futureInterface, waiter.taskId);
+		}
+	}
+}
+
+void StorageEngine::completeRequest(const RequestInfo &info, QVariant result)
+{
+	//primitive results are passed on as they are, without going through the serializer
+	if(result.userType() != info.convertMetaTypeId)
+		result.convert(info.convertMetaTypeId);
+
+	auto waiters = info.waiters;
+	waiters.prepend({info.futureInterface, info.targetThread, info.taskId});
+	foreach(auto waiter, waiters) {
+		if(!waiter.futureInterface.isCanceled())
+			waiter.futureInterface.reportResult(result);
+		registry->finish(waiter.futureInterface, waiter.taskId);
+	}
+}
+
+void StorageEngine::failRequest(const RequestInfo &info, const QException &exception)
+{
+	auto waiters = info.waiters;
+	waiters.prepend({info.futureInterface, info.targetThread, info.taskId});
+	foreach(auto waiter, waiters) {
+		if(!waiter.futureInterface.isCanceled())
+			waiter.futureInterface.reportException(exception);
+		registry->finish(waiter.futureInterface, waiter.taskId);
+	}
+}
+
+void StorageEngine::releaseRequest(quint64 id, const RequestInfo &info)
+{
+	auto typeName = QByteArray(QMetaEnum::fromType<TaskType>().valueToKey(info.taskType));
+
+	QMutexLocker _(&taskMutex);
+	cancelableRequests.remove(id);
+	stats.activeRequests--;
+	addToHistogram(stats.latencyHistograms[typeName], info.timer.nsecsElapsed() / 1000);
+}
+
+void StorageEngine::addToHistogram(QVector<quint64> &histogram, qint64 usecs)
+{
+	static const auto buckets = EngineStatistics::latencyBuckets();
+	if(histogram.isEmpty())
+		histogram.fill(0, buckets.size() + 1);
+	histogram[std::upper_bound(buckets.begin(), buckets.end(), usecs) - buckets.begin()]++;
+}
+
+void StorageEngine::notifyChange(int metaTypeId, const QString &key, bool wasDeleted, const QJsonObject &data, quint64 origin)
+{
+	emit notifyChanged(metaTypeId, key, wasDeleted);
+	//only the last change of a dataset is reported, together with the origin of that change
+	auto &typeNotifies = pendingNotifies[metaTypeId];
+	for(auto it = typeNotifies.begin(); it != typeNotifies.end();) {
+		if(it.key() != origin && it->remove(key) > 0 && it->isEmpty())
+			it = typeNotifies.erase(it);
+		else
+			it++;
+	}
+	//the written data is passed on, so receivers do not have to load it again
+	typeNotifies[origin].insert(key, wasDeleted ? QJsonValue(QJsonValue::Null) : QJsonValue(data));
+	if(!notifyTimer->isActive())
+		notifyTimer->start();
+}
+
+StorageShard *StorageEngine::shardFor(const QByteArray &typeName) const
+{
+	return shards[qHash(typeName) % shards.size()];
+}
+
+void StorageEngine::drainShards()
+{
+	foreach(auto shard, shards)
+		shard->drain();
+}
+
+void StorageEngine::beginConvert(const Waiter &waiter, int convertMetaTypeId, const QJsonValue &result, bool projected)
+{
+	//deserialization runs on the pool, the engine thread only does storage and bookkeeping
+	convertPool->start(new ConvertRunnable(serializer, registry, waiter, convertMetaTypeId, result, projected));
+}
+
+void StorageEngine::beginConvertMany(const Waiter &waiter, int convertMetaTypeId, const QJsonObject &result)
+{
+	//the datasets are split into chunks, so they can be deserialized in parallel
+	static const int ChunkSize = 32;
+
+	QSharedPointer<ConvertManyRunnable::Result> convertResult(new ConvertManyRunnable::Result());
+	convertResult->registry = registry;
+	convertResult->waiter = waiter;
+	convertResult->pending = (result.size() + ChunkSize - 1) / ChunkSize;
+	convertResult->failed = false;
+	if(convertResult->pending == 0) {
+		waiter.futureInterface.reportResult(QVariant(QVariantHash()));
+		registry->finish(waiter.futureInterface, waiter.taskId);
+		return;
+	}
+
+	QJsonObject chunk;
+	for(auto it = result.constBegin(); it != result.constEnd(); it++) {
+		chunk.insert(it.key(), it.value());
+		if(chunk.size() == ChunkSize) {
+			convertPool->start(new ConvertManyRunnable(serializer, convertResult, convertMetaTypeId, chunk));
+			chunk = QJsonObject();
+		}
+	}
+	if(!chunk.isEmpty())
+		convertPool->start(new ConvertManyRunnable(serializer, convertResult, convertMetaTypeId, chunk));
+}
+
+void StorageEngine::tryMoveToThread(QVariant object, QThread *thread)
+{
+	if(object.userType() == QMetaType::QVariantHash) {
+		foreach(auto obj, object.toHash())
+			tryMoveToThread(obj, thread);
+	} else if(object.canConvert<QVariantList>()) {
+		//iterating the list directly avoids converting it to a QVariantList copy first
+		foreach(auto obj, object.value<QSequentialIterable>())
 			tryMoveToThread(obj, thread);
 	} else {
 		auto obj = object.value<QObject*>();
@@ -436,28 +1196,139 @@ void StorageEngine::tryMoveToThread(QVariant object, QThread *thread) const
 	}
 }
 
+QVariant StorageEngine::deserializeProjected(const QJsonSerializer *serializer, int metaTypeId, const QJsonArray &array)
+{
+	//each property is deserialized on it's own, using the type of the property
+	auto metaObject = QMetaType::metaObjectForType(metaTypeId);
+	QList<QVariantMap> result;
+	foreach(auto value, array) {
+		auto object = value.toObject();
+		QVariantMap data;
+		for(auto it = object.constBegin(); it != object.constEnd(); it++) {
+			auto property = metaObject->property(metaObject->indexOfProperty(it.key().toUtf8().constData()));
+			if(property.isValid())
+				data.insert(it.key(), serializer->deserialize(it.value(), property.userType()));
+		}
+		result.append(data);
+	}
+	return QVariant::fromValue(result);
+}
+
 
 
 StorageEngine::RequestInfo::RequestInfo(bool isChangeControllerRequest) :
 	isChangeControllerRequest(isChangeControllerRequest),
 	futureInterface(),
 	targetThread(nullptr),
+	taskId(0),
 	convertMetaTypeId(QMetaType::UnknownType),
+	taskType(Count),
+	timer(),
+	waiters(),
+	loadKey(),
+	projection(),
+	loadManyKeys(),
+	loadManyKeyProperty(),
 	notifyKey(),
 	isDeleteAction(false),
+	notifyData(),
+	notifyOrigin(0),
 	changeAction(false),
 	changeKey(),
 	changeState(StateHolder::Unchanged)
 {}
 
-StorageEngine::RequestInfo::RequestInfo(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int convertMetaTypeId) :
+StorageEngine::RequestInfo::RequestInfo(const TaskInfo &task, int convertMetaTypeId) :
 	isChangeControllerRequest(false),
-	futureInterface(futureInterface),
-	targetThread(targetThread),
+	futureInterface(task.futureInterface),
+	targetThread(task.targetThread),
+	taskId(task.taskId),
 	convertMetaTypeId(convertMetaTypeId),
+	taskType(task.taskType),
+	timer(task.timer),
+	waiters(task.waiters),
+	loadKey(),
+	projection(),
+	loadManyKeys(),
+	loadManyKeyProperty(),
 	notifyKey(),
 	isDeleteAction(false),
+	notifyData(),
+	notifyOrigin(task.origin),
 	changeAction(false),
 	changeKey(),
 	changeState(StateHolder::Unchanged)
 {}
+
+
+
+StorageEngine::ConvertRunnable::ConvertRunnable(const QJsonSerializer *serializer, const QSharedPointer<TaskRegistry> &registry, const Waiter &waiter, int convertMetaTypeId, const QJsonValue &result, bool projected) :
+	QRunnable(),
+	serializer(serializer),
+	registry(registry),
+	waiter(waiter),
+	convertMetaTypeId(convertMetaTypeId),
+	result(result),
+	projected(projected)
+{}
+
+void StorageEngine::ConvertRunnable::run()
+{
+	if(waiter.futureInterface.isCanceled()) {
+		registry->finish(waiter.futureInterface, waiter.taskId);
+		return;
+	}
+
+	try {
+		auto obj = projected ?
+					   deserializeProjected(serializer, convertMetaTypeId, result.toArray()) :
+					   serializer->deserialize(result, convertMetaTypeId);
+		if(waiter.targetThread)
+			tryMoveToThread(obj, waiter.targetThread);
+		waiter.futureInterface.reportResult(obj);
+	} catch(QJsonSerializerException &e) {
+		waiter.futureInterface.reportException(e);
+	}
+
+	registry->finish(waiter.futureInterface, waiter.taskId);
+}
+
+
+
+StorageEngine::ConvertManyRunnable::ConvertManyRunnable(const QJsonSerializer *serializer, const QSharedPointer<Result> &result, int convertMetaTypeId, const QJsonObject &chunk) :
+	QRunnable(),
+	serializer(serializer),
+	result(result),
+	convertMetaTypeId(convertMetaTypeId),
+	chunk(chunk)
+{}
+
+void StorageEngine::ConvertManyRunnable::run()
+{
+	auto &waiter = result->waiter;
+	QVariantHash data;
+	if(!waiter.futureInterface.isCanceled()) {
+		try {
+			for(auto it = chunk.constBegin(); it != chunk.constEnd(); it++) {
+				auto obj = serializer->deserialize(it.value(), convertMetaTypeId);
+				if(waiter.targetThread)
+					tryMoveToThread(obj, waiter.targetThread);
+				data.insert(it.key(), obj);
+			}
+		} catch(QJsonSerializerException &e) {
+			QMutexLocker _(&result->mutex);
+			if(!result->failed) {
+				result->failed = true;
+				waiter.futureInterface.reportException(e);
+			}
+		}
+	}
+
+	QMutexLocker _(&result->mutex);
+	result->data.unite(data);
+	if(--result->pending == 0) {
+		if(!result->failed && !waiter.futureInterface.isCanceled())
+			waiter.futureInterface.reportResult(QVariant(result->data));
+		result->registry->finish(waiter.futureInterface, waiter.taskId);
+	}
+}
@@ -9,11 +9,23 @@
 #include "remoteconnector.h"
 #include "stateholder.h"
 #include "encryptor.h"
+#include "enginestatistics.h"
+#include "setup.h"
+#include "slotmap_p.h"
+#include "storageshard_p.h"
+#include "tasknotifier_p.h"
 
 #include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QFuture>
+#include <QtCore/QJsonArray>
+#include <QtCore/QMutex>
 #include <QtCore/QObject>
+#include <QtCore/QQueue>
 #include <QtCore/QReadWriteLock>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QThreadPool>
+#include <QtCore/QTimer>
 
 #include <QtJsonSerializer/QJsonSerializer>
 
@@ -33,36 +45,67 @@ public:
 		Keys,
 		LoadAll,
 		Load,
+		LoadMany,
+		LoadAllProjected,
 		Save,
 		Remove,
-		Search
+		Search,
+		ChangesSince
 	};
 	Q_ENUM(TaskType)
 
+	enum RequestLane {
+		Interactive,
+		Sync,
+		Background
+	};
+	Q_ENUM(RequestLane)
+
+	//a future waiting for the result of a request, the thread to deliver it to and the id it is tracked with
+	struct Waiter {
+		QFutureInterface<QVariant> futureInterface;
+		QThread *targetThread;
+		quint64 taskId;
+	};
+
 	explicit StorageEngine(Defaults *defaults,
 						   QJsonSerializer *serializer,
 						   LocalStore *localStore,
 						   StateHolder *stateHolder,
 						   RemoteConnector *remoteConnector,
 						   DataMerger *dataMerger,
-						   Encryptor *encryptor);
+						   Encryptor *encryptor,
+						   int shardCount = 1);
 
 	bool isSyncEnabled() const;
 	SyncController::SyncState syncState() const;
 	QString authenticationError() const;
 
+	QJsonObject serializeValue(int metaTypeId, QVariant value) const;
+	QVariant deserializeValue(int metaTypeId, const QJsonObject &data) const;
+	EngineStatistics statistics() const;
+	QDir storageDir() const;
+	const QLoggingCategory &loggingCategory() const;
+	bool cacheSnapshots() const;
+
+	void setRequestLimit(int limit, Setup::RequestLimitPolicy policy);
+	void setCacheSnapshots(bool cacheSnapshots);
+	QSharedPointer<TaskRegistry> taskRegistry() const;
+	void submitTask(const Waiter &waiter,
+					TaskType taskType,
+					int metaTypeId,
+					const QVariant &value = {},
+					RequestLane lane = Interactive,
+					quint64 origin = 0);
+
 public Q_SLOTS:
-	void beginTask(QFutureInterface<QVariant> futureInterface,
-				   QThread *targetThread,
-				   QtDataSync::StorageEngine::TaskType taskType,
-				   int metaTypeId,
-				   const QVariant &value = {});
 	void triggerSync();
 	void triggerResync();
 	void setSyncEnabled(bool syncEnabled);
 
 Q_SIGNALS:
 	void notifyChanged(int metaTypeId, const QString &key, bool wasDeleted);
+	void notifyChangedBatch(int metaTypeId, const QStringList &changed, const QStringList &deleted, const QJsonObject &changedData, quint64 origin);
 	void notifyResetted();
 
 	void syncEnabledChanged(bool syncEnabled);
@@ -74,7 +117,10 @@ private Q_SLOTS:
 	void initialize();
 	void finalize();
 
+	void processTasks();
+	void flushNotifications();
 	void requestCompleted(quint64 id, const QJsonValue &result);
+	void requestResultReady(quint64 id, const QVariant &result);
 	void requestFailed(quint64 id, const QString &errorString);
 	void operationDone(const QJsonValue &result);
 	void operationFailed(const QString &errorString);
@@ -89,6 +135,31 @@ private Q_SLOTS:
 	void performLocalReset(bool clearStore);
 
 private:
+	class ConvertRunnable;
+	class ConvertManyRunnable;
+
+	static const int LaneCount = Background + 1;
+
+	struct Q_DATASYNC_EXPORT TaskInfo {
+		RequestLane lane;
+		QElapsedTimer timer;
+
+		//change controller
+		bool isChangeControllerTask;
+		ChangeController::ChangeOperation operation;
+
+		//store requests
+		QFutureInterface<QVariant> futureInterface;
+		QThread *targetThread;
+		quint64 taskId;
+		TaskType taskType;
+		int metaTypeId;
+		QString key;
+		QVariant value;
+		QList<Waiter> waiters;
+		quint64 origin;
+	};
+
 	struct Q_DATASYNC_EXPORT RequestInfo {
 		//change controller
 		bool isChangeControllerRequest;
@@ -96,11 +167,21 @@ private:
 		//store requests
 		QFutureInterface<QVariant> futureInterface;
 		QThread *targetThread;
+		quint64 taskId;
 		int convertMetaTypeId;
+		TaskType taskType;
+		QElapsedTimer timer;
+		QList<Waiter> waiters;
+		ObjectKey loadKey;
+		QStringList projection;
+		QStringList loadManyKeys;
+		QString loadManyKeyProperty;
 
 		//change notifying
 		ObjectKey notifyKey;
 		bool isDeleteAction;
+		QJsonObject notifyData;
+		quint64 notifyOrigin;
 
 		//changing operations
 		bool changeAction;
@@ -108,8 +189,7 @@ private:
 		StateHolder::ChangeState changeState;
 
 		RequestInfo(bool isChangeControllerRequest = false);
-		RequestInfo(QFutureInterface<QVariant> futureInterface,
-					QThread *targetThread,
+		RequestInfo(const TaskInfo &task,
 					int convertMetaTypeId = QMetaType::UnknownType);
 	};
 
@@ -120,23 +200,72 @@ private:
 	RemoteConnector *remoteConnector;
 	Encryptor *encryptor;
 	ChangeController *changeController;
+	QThreadPool *convertPool;
+	QSharedPointer<TaskRegistry> registry;
 
-	QHash<quint64, RequestInfo> requestCache;
-	quint64 requestCounter;
+	int shardCount;
+	QList<StorageShard*> shards;
+
+	SlotMap<RequestInfo> requestCache;
+	QHash<ObjectKey, quint64> activeLoads;
+
+	QTimer *notifyTimer;
+	QHash<int, QHash<quint64, QHash<QString, QJsonValue>>> pendingNotifies;//by type and origin, null for deleted datasets
+
+	mutable QMutex taskMutex;
+	QQueue<QSharedPointer<TaskInfo>> taskQueues[LaneCount];
+	QQueue<QSharedPointer<TaskInfo>> delayedTasks;//requests over the limit, admitted in order once there is room
+	QHash<int, QHash<QString, QSharedPointer<TaskInfo>>> queuedSaves;
+	QHash<ObjectKey, int> queuedSyncWrites;//change controller writes per dataset, that user writes must not overtake
+	QHash<quint64, QList<QFutureInterface<QVariant>>> cancelableRequests;
+	bool processScheduled;
+	int requestLimit;
+	Setup::RequestLimitPolicy requestLimitPolicy;
+	bool snapshotsEnabled;
+	EngineStatistics stats;
 
 	mutable QReadWriteLock controllerLock;
 	SyncController::SyncState currentSyncState;
 	QString currentAuthError;
 
-	void count(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int metaTypeId);
-	void keys(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int metaTypeId);
-	void loadAll(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int dataMetaTypeId, int listMetaTypeId);
-	void load(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int metaTypeId, const QByteArray &keyProperty, const QString &value);
-	void save(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int metaTypeId, const QByteArray &keyProperty, QVariant value);
-	void remove(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int metaTypeId, const QByteArray &keyProperty, const QString &value);
-	void search(QFutureInterface<QVariant> futureInterface, QThread *targetThread, int dataMetaTypeId, QPair<int, QString> data);
+	int queuedTasks(bool requestsOnly) const;
+	bool coalesceTask(const QSharedPointer<TaskInfo> &task);
+	void admitDelayedTasks();
+	void enqueueTask(const QSharedPointer<TaskInfo> &task);
+	QSharedPointer<TaskInfo> nextTask();
+	static bool isSyncWrite(const TaskInfo &task);
+	void startLocalOperation(const ChangeController::ChangeOperation &operation);
+	static bool dropCanceled(TaskInfo &task);
+	bool isRequestCanceled(quint64 id) const;
+	void beginTask(const TaskInfo &task);
+	quint64 registerRequest(const RequestInfo &info);
+	void count(const TaskInfo &task);
+	void keys(const TaskInfo &task);
+	void loadAll(const TaskInfo &task);
+	void loadAllProjected(const TaskInfo &task, const QMetaObject *metaObject);
+	void load(const TaskInfo &task, const QByteArray &keyProperty);
+	void loadMany(const TaskInfo &task, const QByteArray &keyProperty);
+	void save(const TaskInfo &task, const QByteArray &keyProperty);
+	void remove(const TaskInfo &task, const QByteArray &keyProperty);
+	void search(const TaskInfo &task);
+	void changesSince(const TaskInfo &task);
+	RequestInfo takeRequest(quint64 id);
+	void finishChange(const RequestInfo &info, bool removed);
+	void completeRequest(const RequestInfo &info, QJsonValue result);
+	void completeRequest(const RequestInfo &info, QVariant result);
+	void failRequest(const RequestInfo &info, const QException &exception);
+	void releaseRequest(quint64 id, const RequestInfo &info);
+	static void addToHistogram(QVector<quint64> &histogram, qint64 usecs);
+
+	void notifyChange(int metaTypeId, const QString &key, bool wasDeleted, const QJsonObject &data = QJsonObject(), quint64 origin = 0);
+
+	StorageShard *shardFor(const QByteArray &typeName) const;
+	void drainShards();
 
-	void tryMoveToThread(QVariant object, QThread *thread) const;
+	void beginConvert(const Waiter &waiter, int convertMetaTypeId, const QJsonValue &result, bool projected = false);
+	void beginConvertMany(const Waiter &waiter, int convertMetaTypeId, const QJsonObject &result);
+	static void tryMoveToThread(QVariant object, QThread *thread);
+	static QVariant deserializeProjected(const QJsonSerializer *serializer, int metaTypeId, const QJsonArray &array);
 };
 
 }
@@ -0,0 +1,81 @@
+#include "storageshard_p.h"
+
+using namespace QtDataSync;
+
+StorageShard::StorageShard(LocalStore *store, bool ownThread, QObject *parent) :
+	QObject(parent),
+	localStore(store),
+	storeThread(ownThread ? new QThread(this) : nullptr)
+{
+	//auto connections: direct for a store on the engine thread, queued for shard threads
+	connect(this, &StorageShard::count,
+			localStore, &LocalStore::count);
+	connect(this, &StorageShard::keys,
+			localStore, &LocalStore::keys);
+	connect(this, &StorageShard::loadAll,
+			localStore, &LocalStore::loadAll);
+	connect(this, &StorageShard::loadAllProjected,
+			localStore, &LocalStore::loadAllProjected);
+	connect(this, &StorageShard::load,
+			localStore, &LocalStore::load);
+	connect(this, &StorageShard::loadMany,
+			localStore, &LocalStore::loadMany);
+	connect(this, &StorageShard::save,
+			localStore, &LocalStore::save);
+	connect(this, &StorageShard::remove,
+			localStore, &LocalStore::remove);
+	connect(this, &StorageShard::search,
+			localStore, &LocalStore::search);
+	connect(this, &StorageShard::changesSince,
+			localStore, &LocalStore::changesSince);
+}
+
+LocalStore *StorageShard::store() const
+{
+	return localStore;
+}
+
+bool StorageShard::hasOwnThread() const
+{
+	return storeThread;
+}
+
+void StorageShard::initialize(Defaults *defaults)
+{
+	if(!storeThread) {
+		localStore->initialize(defaults);
+		return;
+	}
+
+	auto store = localStore;
+	localStore->setParent(nullptr);
+	localStore->moveToThread(storeThread);
+	connect(storeThread, &QThread::started, store, [store, defaults](){
+		store->initialize(defaults);
+	});
+	connect(storeThread, &QThread::finished, store, [store](){
+		store->finalize();
+	}, Qt::DirectConnection);//runs on the shard thread, after the event loop stopped
+	connect(storeThread, &QThread::finished,
+			store, &LocalStore::deleteLater);
+	connect(this, &StorageShard::drainRequested,
+			store, [](){},
+			Qt::BlockingQueuedConnection);
+	storeThread->start();
+}
+
+void StorageShard::finalize()
+{
+	if(storeThread) {
+		storeThread->quit();
+		storeThread->wait();
+	} else
+		localStore->finalize();
+}
+
+void StorageShard::drain()
+{
+	//all requests queued before this one have been processed once it returns
+	if(storeThread && storeThread->isRunning())
+		emit drainRequested();
+}
@@ -0,0 +1,48 @@
+#ifndef QTDATASYNC_STORAGESHARD_P_H
+#define QTDATASYNC_STORAGESHARD_P_H
+
+#include "qtdatasync_global.h"
+#include "defaults.h"
+#include "localstore.h"
+
+#include <QtCore/QObject>
+#include <QtCore/QThread>
+
+namespace QtDataSync {
+
+class Q_DATASYNC_EXPORT StorageShard : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit StorageShard(LocalStore *store, bool ownThread, QObject *parent = nullptr);
+
+	LocalStore *store() const;
+	bool hasOwnThread() const;
+
+	void initialize(Defaults *defaults);
+	void finalize();
+	void drain();
+
+Q_SIGNALS:
+	void count(quint64 id, const QByteArray &typeName);
+	void keys(quint64 id, const QByteArray &typeName);
+	void loadAll(quint64 id, const QByteArray &typeName);
+	void loadAllProjected(quint64 id, const QByteArray &typeName, const QStringList &properties);
+	void load(quint64 id, const ObjectKey &key, const QByteArray &keyProperty);
+	void loadMany(quint64 id, const QByteArray &typeName, const QStringList &keys, const QByteArray &keyProperty);
+	void save(quint64 id, const ObjectKey &key, const QJsonObject &object, const QByteArray &keyProperty);
+	void remove(quint64 id, const ObjectKey &key, const QByteArray &keyProperty);
+	void search(quint64 id, const QByteArray &typeName, const QString &searchQuery);
+	void changesSince(quint64 id, const QByteArray &typeName, quint64 sequence);
+
+	void drainRequested();
+
+private:
+	LocalStore *localStore;
+	QThread *storeThread;
+};
+
+}
+
+#endif // QTDATASYNC_STORAGESHARD_P_H
@@ -45,6 +45,11 @@ QString SyncController::authenticationError() const
 	return d->engine->authenticationError();
 }
 
+EngineStatistics SyncController::engineStatistics() const
+{
+	return d->engine->statistics();
+}
+
 void SyncController::triggerSync()
 {
 	QMetaObject::invokeMethod(d->engine, "triggerSync", Qt::QueuedConnection);
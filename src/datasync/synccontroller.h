@@ -2,6 +2,7 @@
 #define QTDATASYNC_SYNCCONTROLLER_H
 
 #include "QtDataSync/qtdatasync_global.h"
+#include "QtDataSync/enginestatistics.h"
 
 #include <QtCore/qobject.h>
 
@@ -45,6 +46,8 @@ public:
 	SyncState syncState() const;
 	//! @readAcFn{SyncController::authenticationError}
 	QString authenticationError() const;
+	//! Returns the current request load statistics of the datasync instance
+	EngineStatistics engineStatistics() const;
 
 public Q_SLOTS:
 	//! Tells the datasync instance to start synchronizing
@@ -1,5 +1,7 @@
 #include "task.h"
 #include "asyncdatastore.h"
+#include "tasknotifier_p.h"
+#include "propertycopyplan_p.h"
 
 #include <QtCore/QFutureWatcher>
 #include <QtCore/qcoreapplication.h>
@@ -7,11 +9,38 @@
 using namespace QtDataSync;
 
 Task::Task(QFutureInterface<QVariant> d) :
-	QFuture(&d)
+	QFuture(&d),
+	_registry(),
+	_taskId(0)
+{}
+
+Task::Task(QFutureInterface<QVariant> d, const QSharedPointer<TaskRegistry> &registry, quint64 taskId) :
+	QFuture(&d),
+	_registry(registry),
+	_taskId(taskId)
 {}
 
 Task &Task::onResult(QObject *parent, const std::function<void (QVariant)> &onSuccess, const std::function<void(const QException &)> &onExcept)
 {
+	//tasks created by the stores are delivered without a watcher
+	if(_taskId != 0) {
+		TaskNotifier::Continuation continuation;
+		continuation.future = *this;
+		continuation.parent = parent;
+		continuation.thread = parent->thread();
+		continuation.onSuccess = onSuccess;
+		continuation.onExcept = onExcept;
+
+		auto registry = _registry.toStrongRef();
+		if(registry && registry->addContinuation(_taskId, continuation))
+			return *this;
+		//the registry reports before forgetting the task, so a finished task can be posted right away
+		if(isFinished()) {
+			TaskNotifier::post(continuation);
+			return *this;
+		}
+	}
+
 	auto watcher = new QFutureWatcher<QVariant>(parent);
 	QObject::connect(watcher, &QFutureWatcherBase::finished, watcher, [watcher, onSuccess, onExcept](){
 		try {
@@ -38,10 +67,19 @@ Task &Task::onResult(const std::function<void (QVariant)> &onSuccess, const std:
 	return onResult(qApp, onSuccess, onExcept);
 }
 
+void Task::updateObject(QObject *object, const QObject *newObject)
+{
+	PropertyCopyPlan::forClass(object->metaObject())->copy(object, newObject);
+}
+
 GenericTask<void>::GenericTask(QFutureInterface<QVariant> d) :
 	Task(d)
 {}
 
+GenericTask<void>::GenericTask(const Task &task) :
+	Task(task)
+{}
+
 GenericTask<void> &GenericTask<void>::onResult(QObject *parent, const std::function<void ()> &onSuccess, const std::function<void (const QException &)> &onExcept)
 {
 	Task::onResult(parent, [onSuccess](QVariant){
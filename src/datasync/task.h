@@ -11,19 +11,27 @@
 #include <QtCore/qsharedpointer.h>
 #include <QtCore/qscopedpointer.h>
 #include <QtCore/qmetaobject.h>
+#include <QtCore/qthread.h>
 
 #include <functional>
 
 namespace QtDataSync {
 class AsyncDataStore;
+class AsyncDataStorePrivate;
+class TaskRegistry;
 
 template <typename T>
 class GenericTask;
+template <typename TType>
+struct CachingDataStoreTraits;
 
 //! A class to extend QFuture by an onResult handler
 class Q_DATASYNC_EXPORT Task : public QFuture<QVariant>
 {
 	friend class AsyncDataStore;
+	friend class AsyncDataStorePrivate;
+	template <typename TType>
+	friend struct CachingDataStoreTraits;
 
 public:
 	//! @copybrief Task::onResult(const std::function<void(QVariant)> &, const std::function<void(const QException &)> &)
@@ -41,6 +49,15 @@ public:
 protected:
 	//! Constructor with future interface
 	Task(QFutureInterface<QVariant> d);
+	//! Constructor with future interface, tracked by the given registry
+	Task(QFutureInterface<QVariant> d, const QSharedPointer<TaskRegistry> &registry, quint64 taskId);
+
+	//! Copies all stored and dynamic properties that differ from newObject to object
+	static void updateObject(QObject *object, const QObject *newObject);
+
+private:
+	QWeakPointer<TaskRegistry> _registry;
+	quint64 _taskId;
 };
 
 //! Generic version of the Task
@@ -64,6 +81,9 @@ public:
 
 	//! Returns the tasks result
 	T result() const;
+
+private:
+	GenericTask(const Task &task);
 };
 
 //! Generic version of the Task, specialization for void
@@ -86,6 +106,8 @@ public:
 								const std::function<void(const QException &)> &onExcept = {});
 
 private:
+	GenericTask(const Task &task);
+
 	using QFuture<QVariant>::result;
 };
 
@@ -121,6 +143,8 @@ private:
 
 	QSharedPointer<UpdateData> _data;
 
+	UpdateTask(T data, const Task &task);
+
 	static T interalGet(QSharedPointer<UpdateData> data, QVariant result);
 };
 
@@ -129,7 +153,7 @@ private:
 template<typename T>
 GenericTask<T> Task::toGeneric() const
 {
-	return GenericTask<T>(d);
+	return GenericTask<T>(*this);
 }
 
 template<typename T>
@@ -137,6 +161,11 @@ GenericTask<T>::GenericTask(QFutureInterface<QVariant> d) :
 	Task(d)
 {}
 
+template<typename T>
+GenericTask<T>::GenericTask(const Task &task) :
+	Task(task)
+{}
+
 template<typename T>
 GenericTask<T> &GenericTask<T>::onResult(QObject *parent, const std::function<void (T)> &onSuccess, const std::function<void (const QException &)> &onExcept)
 {
@@ -176,6 +205,17 @@ UpdateTask<T>::UpdateTask(T data, QFutureInterface<QVariant> d) :
 	_data->mutex.reset(new QMutex());
 }
 
+template<typename T>
+UpdateTask<T>::UpdateTask(T data, const Task &task) :
+	Task(task),
+	_data(new UpdateData())
+{
+	Q_ASSERT_X(data, Q_FUNC_INFO, "UpdateTask must have an existing data object to update!");
+	_data->data = data;
+	_data->updated = false;
+	_data->mutex.reset(new QMutex());
+}
+
 template<typename T>
 UpdateTask<T> &UpdateTask<T>::onResult(QObject *parent, const std::function<void (T)> &onSuccess, const std::function<void (const QException &)> &onExcept)
 {
@@ -221,17 +261,13 @@ T UpdateTask<T>::interalGet(QSharedPointer<UpdateData> data, QVariant result)
 			if(user.read(newResult).toString() != user.read(data->data).toString())
 				throw DataSyncException("loadInto: The id of the loaded data does not match the one to be updated!");
 
-			//pass on properties
-			for(auto i = 1; i < oldMeta->propertyCount(); i++) {//skip object name
-				auto prop = oldMeta->property(i);
-				if(prop.isStored())
-					prop.write(data->data, prop.read(newResult));
-			}
-			foreach(auto dynProp, newResult->dynamicPropertyNames())
-				data->data->setProperty(dynProp, newResult->property(dynProp));
-
+			updateObject(data->data, newResult);
 			data->updated = true;
-			newResult->deleteLater();
+			//the loaded object has already been moved to the receiving thread
+			if(newResult->thread() == QThread::currentThread())
+				delete newResult;
+			else
+				newResult->deleteLater();
 		} catch(...) {
 			data->mutex->unlock();
 			throw;
@@ -0,0 +1,119 @@
+#include "tasknotifier_p.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDebug>
+
+using namespace QtDataSync;
+
+const QEvent::Type TaskNotifier::ContinuationEvent::EventType = static_cast<QEvent::Type>(QEvent::registerEventType());
+
+QMutex TaskNotifier::notifierMutex;
+QHash<QThread*, TaskNotifier*> TaskNotifier::notifiers;
+
+TaskNotifier::TaskNotifier() :
+	QObject()
+{}
+
+TaskNotifier::~TaskNotifier()
+{
+	QMutexLocker _(&notifierMutex);
+	notifiers.remove(thread());
+}
+
+bool TaskNotifier::event(QEvent *event)
+{
+	if(event->type() == ContinuationEvent::EventType) {
+		auto continuationEvent = static_cast<ContinuationEvent*>(event);
+		if(continuationEvent->continuation.parent)
+			run(continuationEvent->continuation);
+		return true;
+	} else
+		return QObject::event(event);
+}
+
+void TaskNotifier::post(const Continuation &continuation)
+{
+	QMutexLocker _(&notifierMutex);
+	auto notifier = notifiers.value(continuation.thread);
+	if(!notifier) {
+		//one notifier per thread delivers the results of all tasks for that thread
+		notifier = new TaskNotifier();
+		notifier->moveToThread(continuation.thread);
+		connect(continuation.thread, &QThread::finished,
+				notifier, &TaskNotifier::deleteLater);
+		notifiers.insert(continuation.thread, notifier);
+	}
+	QCoreApplication::postEvent(notifier, new ContinuationEvent(continuation));
+}
+
+void TaskNotifier::run(const Continuation &continuation)
+{
+	try {
+		continuation.future.waitForFinished();//rethrows reported exceptions
+		if(continuation.future.resultCount() == 0)//canceled
+			return;
+		if(continuation.onSuccess)
+			continuation.onSuccess(continuation.future.result());
+	} catch (QException &e) {
+		if(continuation.onExcept)
+			continuation.onExcept(e);
+		else {
+			qCritical() << "Unhandelt exception in Task. Exception was:"
+						<< e.what();
+		}
+	}
+}
+
+
+
+TaskNotifier::ContinuationEvent::ContinuationEvent(const Continuation &continuation) :
+	QEvent(EventType),
+	continuation(continuation)
+{}
+
+
+
+TaskRegistry::TaskRegistry() :
+	mutex(),
+	nextId(1),
+	continuations()
+{}
+
+quint64 TaskRegistry::track()
+{
+	QMutexLocker _(&mutex);
+	auto taskId = nextId++;
+	continuations.insert(taskId, {});
+	return taskId;
+}
+
+void TaskRegistry::finish(QFutureInterface<QVariant> futureInterface, quint64 taskId)
+{
+	futureInterface.reportFinished();
+
+	QList<TaskNotifier::Continuation> pending;
+	{
+		QMutexLocker _(&mutex);
+		pending = continuations.take(taskId);
+	}
+	foreach(auto continuation, pending)
+		TaskNotifier::post(continuation);
+}
+
+bool TaskRegistry::addContinuation(quint64 taskId, const TaskNotifier::Continuation &continuation)
+{
+	QMutexLocker _(&mutex);
+	auto it = continuations.find(taskId);
+	if(it != continuations.end()) {
+		it->append(continuation);
+		return true;
+	} else
+		return false;
+}
+
+void TaskRegistry::clear()
+{
+	//tasks that have not been finished until now never will be, so their handlers are dropped
+	QMutexLocker _(&mutex);
+	continuations.clear();
+}
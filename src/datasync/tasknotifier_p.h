@@ -0,0 +1,79 @@
+#ifndef QTDATASYNC_TASKNOTIFIER_P_H
+#define QTDATASYNC_TASKNOTIFIER_P_H
+
+#include "qtdatasync_global.h"
+
+#include <QtCore/QEvent>
+#include <QtCore/QException>
+#include <QtCore/QFuture>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QThread>
+
+#include <functional>
+
+namespace QtDataSync {
+
+class Q_DATASYNC_EXPORT TaskNotifier : public QObject
+{
+	Q_OBJECT
+
+public:
+	typedef std::function<void(QVariant)> SuccessHandler;
+	typedef std::function<void(const QException &)> ExceptHandler;
+
+	struct Continuation {
+		QFuture<QVariant> future;
+		QPointer<QObject> parent;
+		QThread *thread;
+		SuccessHandler onSuccess;
+		ExceptHandler onExcept;
+	};
+
+	~TaskNotifier();
+
+	static void post(const Continuation &continuation);
+
+protected:
+	bool event(QEvent *event) override;
+
+private:
+	class ContinuationEvent : public QEvent
+	{
+	public:
+		static const QEvent::Type EventType;
+
+		ContinuationEvent(const Continuation &continuation);
+
+		Continuation continuation;
+	};
+
+	static QMutex notifierMutex;
+	static QHash<QThread*, TaskNotifier*> notifiers;
+
+	explicit TaskNotifier();
+
+	static void run(const Continuation &continuation);
+};
+
+class Q_DATASYNC_EXPORT TaskRegistry
+{
+public:
+	TaskRegistry();
+
+	quint64 track();
+	void finish(QFutureInterface<QVariant> futureInterface, quint64 taskId);
+	bool addContinuation(quint64 taskId, const TaskNotifier::Continuation &continuation);
+	void clear();
+
+private:
+	QMutex mutex;
+	quint64 nextId;
+	QHash<quint64, QList<TaskNotifier::Continuation>> continuations;
+};
+
+}
+
+#endif // QTDATASYNC_TASKNOTIFIER_P_H
@@ -5,11 +5,14 @@
 %classnames = (
 	"asyncdatastore.h" => "AsyncDataStore",
 	"authenticator.h" => "Authenticator",
-	"cachingdatastore.h" => "CachingDataStoreBase,CachingDataStore",
+	"cachingdatastore.h" => "CachingDataStoreBase,CachingDataStore,CachingDataStoreRange",
+	"cachingdatastoremodel.h" => "CachingDataStoreModelBase,CachingDataStoreModel",
+	"changeset.h" => "ChangeSet",
 	"datamerger.h" => "DataMerger",
 	"defaults.h" => "Defaults",
 	"encryptor.h" => "Encryptor",
-	"exceptions.h" => "SetupException,SetupExistsException,SetupLockedException,InvalidDataException,DataSyncException",
+	"enginestatistics.h" => "EngineStatistics",
+	"exceptions.h" => "SetupException,SetupExistsException,SetupLockedException,InvalidDataException,DataSyncException,EngineOverloadedException",
 	"localstore.h" => "LocalStore",
 	"remoteconnector.h" => "RemoteConnector",
 	"setup.h" => "Setup",
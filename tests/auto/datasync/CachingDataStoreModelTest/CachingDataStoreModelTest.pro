@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# Project created by QtCreator 2017-05-02T14:21:37
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+include (../tests.pri)
+
+TARGET = tst_cachingdatastoremodel
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += tst_cachingdatastoremodel.cpp
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
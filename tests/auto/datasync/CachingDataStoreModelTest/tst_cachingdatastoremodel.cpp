@@ -0,0 +1,181 @@
+#include <QString>
+#include <QtTest>
+#include <QCoreApplication>
+#include "tst.h"
+using namespace QtDataSync;
+
+class CachingDataStoreModelTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void testLoad();
+	void testChanges();
+	void testBatchedRemove();
+	void testFetchMore();
+
+private:
+	AsyncDataStore *async;
+	CachingDataStoreModel<TestData, int> *model;
+
+	QList<int> rowKeys() const;
+};
+
+void CachingDataStoreModelTest::initTestCase()
+{
+#ifdef Q_OS_LINUX
+	Q_ASSERT(qgetenv("LD_PRELOAD").contains("Qt5DataSync"));
+#endif
+
+	tst_init();
+
+	Setup setup;
+	mockSetup(setup);
+	static_cast<MockLocalStore*>(setup.localStore())->enabled = true;
+	setup.create();
+
+	async = new AsyncDataStore(this);
+	for(auto i = 0; i < 10; i++)
+		async->save<TestData>(generateData(i)).waitForFinished();
+}
+
+void CachingDataStoreModelTest::cleanupTestCase()
+{
+	delete model;
+	delete async;
+	Setup::removeSetup(Setup::DefaultSetup);
+}
+
+void CachingDataStoreModelTest::testLoad()
+{
+	model = new CachingDataStoreModel<TestData, int>(this);
+	QSignalSpy resetSpy(model, &QAbstractItemModel::modelReset);
+	QVERIFY(resetSpy.wait());
+
+	QCOMPARE(model->rowCount(), 10);
+	auto keys = rowKeys();
+	std::sort(keys.begin(), keys.end());
+	QCOMPARE(keys, QList<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+
+	auto roles = model->roleNames();
+	QCOMPARE(roles.value(Qt::UserRole), QByteArray("id"));
+	QCOMPARE(roles.value(Qt::UserRole + 1), QByteArray("text"));
+
+	auto index = model->indexOf(4);
+	QVERIFY(index.isValid());
+	QCOMPARE(model->key(index), 4);
+	QCOMPARE(model->object(index), generateData(4));
+	QCOMPARE(model->data(index, Qt::DisplayRole).toString(), QStringLiteral("4"));
+	QCOMPARE(model->data(index, Qt::UserRole).toInt(), 4);
+	QCOMPARE(model->data(index, Qt::UserRole + 1).toString(), QStringLiteral("4"));
+}
+
+void CachingDataStoreModelTest::testChanges()
+{
+	QVERIFY(model);
+
+	try {
+		model->setBatchDelay(60000);//only flush manually
+		QSignalSpy resetSpy(model, &QAbstractItemModel::modelReset);
+		QSignalSpy insertSpy(model, &QAbstractItemModel::rowsInserted);
+		QSignalSpy removeSpy(model, &QAbstractItemModel::rowsRemoved);
+		QSignalSpy changeSpy(model, &QAbstractItemModel::dataChanged);
+
+		auto keys = rowKeys();
+		auto removedRow = keys.indexOf(5);
+		async->save<TestData>(generateData(20)).waitForFinished();
+		async->save<TestData>(TestData(3, QStringLiteral("changed"))).waitForFinished();
+		async->remove<TestData>(5).waitForFinished();
+
+		auto store = model->store();
+		QTRY_VERIFY(store->contains(20) &&
+					!store->contains(5) &&
+					store->load(3).text == QStringLiteral("changed"));
+		QCOMPARE(model->rowCount(), 10);//nothing applied yet
+		model->flush();
+
+		QCOMPARE(resetSpy.size(), 0);
+		QCOMPARE(removeSpy.size(), 1);
+		QCOMPARE(removeSpy[0][1].toInt(), removedRow);
+		QCOMPARE(removeSpy[0][2].toInt(), removedRow);
+		QCOMPARE(insertSpy.size(), 1);
+		QCOMPARE(insertSpy[0][1].toInt(), 9);
+		QCOMPARE(insertSpy[0][2].toInt(), 9);
+		QCOMPARE(changeSpy.size(), 1);
+
+		//the other rows keep their order
+		keys.removeOne(5);
+		keys.append(20);
+		QCOMPARE(rowKeys(), keys);
+		auto changedIndex = changeSpy[0][0].value<QModelIndex>();
+		QCOMPARE(changedIndex, model->indexOf(3));
+		QCOMPARE(model->data(changedIndex, Qt::UserRole + 1).toString(), QStringLiteral("changed"));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void CachingDataStoreModelTest::testBatchedRemove()
+{
+	QVERIFY(model);
+
+	try {
+		QSignalSpy removeSpy(model, &QAbstractItemModel::rowsRemoved);
+
+		auto keys = rowKeys();
+		for(auto i = 2; i < 6; i++)
+			async->remove<TestData>(keys[i]).waitForFinished();
+		QTRY_COMPARE(model->store()->count(), 6);
+		model->flush();
+
+		//neighbouring rows are removed as one range
+		QCOMPARE(removeSpy.size(), 1);
+		QCOMPARE(removeSpy[0][1].toInt(), 2);
+		QCOMPARE(removeSpy[0][2].toInt(), 5);
+		keys.erase(keys.begin() + 2, keys.begin() + 6);
+		QCOMPARE(rowKeys(), keys);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void CachingDataStoreModelTest::testFetchMore()
+{
+	try {
+		CachingDataStoreModel<TestData, int> lazyModel(new CachingDataStore<TestData, int>(CachingDataStoreBase::KeyCache, this));
+		lazyModel.setFetchSize(4);
+		QSignalSpy resetSpy(&lazyModel, &QAbstractItemModel::modelReset);
+		QVERIFY(resetSpy.wait());
+
+		QCOMPARE(lazyModel.rowCount(), 0);
+		QVERIFY(lazyModel.canFetchMore(QModelIndex()));
+		lazyModel.fetchMore(QModelIndex());
+		QCOMPARE(lazyModel.rowCount(), 4);
+		lazyModel.fetchMore(QModelIndex());
+		QCOMPARE(lazyModel.rowCount(), 6);
+		QVERIFY(!lazyModel.canFetchMore(QModelIndex()));
+
+		//fetched rows are prefetched into the cache
+		auto store = lazyModel.store();
+		QTRY_VERIFY(store->isCached(lazyModel.key(lazyModel.index(0))));
+		QTRY_VERIFY(store->isCached(lazyModel.key(lazyModel.index(5))));
+		delete store;
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+QList<int> CachingDataStoreModelTest::rowKeys() const
+{
+	QList<int> keys;
+	for(auto i = 0; i < model->rowCount(); i++)
+		keys.append(model->key(model->index(i)));
+	return keys;
+}
+
+QTEST_MAIN(CachingDataStoreModelTest)
+
+#include "tst_cachingdatastoremodel.moc"
@@ -16,6 +16,14 @@ private Q_SLOTS:
 	void testLoad();
 	void testSave();
 	void testDelete();
+	void testChangedBatch();
+	void testChangePayload();
+	void testKeyCache();
+	void testSharedCache();
+	void testIndexes();
+	void testSnapshot();
+	void testProgressive();
+	void testWriteBehind();
 
 private:
 	AsyncDataStore *async;
@@ -108,12 +116,12 @@ void CachingDataStoreTest::testSave()
 		QCOMPARE(caching->count(), 1);
 		QCOMPARE(caching->keys(), QList<int>({42}));
 
-		QVERIFY(changedSpy.wait());
 		QCOMPARE(changedSpy.size(), 1);
 		QCOMPARE(changedSpy[0][0].toString(), QStringLiteral("42"));
 		QCOMPARE(changedSpy[0][1].value<TestData>(), generateData(42));
 
 		QCOMPARE(async->load<TestData>(42).result(), generateData(42));
+		QVERIFY(!changedSpy.wait(500));//the engine notification for the own save is skipped
 	} catch(QException &e) {
 		QFAIL(e.what());
 	}
@@ -132,12 +140,363 @@ void CachingDataStoreTest::testDelete()
 		QCOMPARE(caching->count(), 0);
 		QCOMPARE(caching->keys(), QList<int>());
 
-		QVERIFY(changedSpy.wait());
 		QCOMPARE(changedSpy.size(), 1);
 		QCOMPARE(changedSpy[0][0].toString(), QStringLiteral("42"));
 		QVERIFY(!changedSpy[0][1].isValid());
 
 		QVERIFY_EXCEPTION_THROWN(async->load<TestData>(42).result(), DataSyncException);
+		QVERIFY(!changedSpy.wait(500));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void CachingDataStoreTest::testChangedBatch()
+{
+	QVERIFY(caching);
+
+	try {
+		QSignalSpy batchSpy(async, &AsyncDataStore::dataChangedBatch);
+
+		async->save<TestData>(generateData(10)).waitForFinished();
+		async->save<TestData>(generateData(11)).waitForFinished();
+		async->save<TestData>(generateData(12)).waitForFinished();
+		async->remove<TestData>(11).waitForFinished();
+
+		auto mergeBatches = [&](){
+			QHash<QString, bool> changes;
+			foreach(auto batch, batchSpy) {
+				if(batch[0].toInt() != qMetaTypeId<TestData>())
+					continue;
+				foreach(auto key, batch[1].toStringList())
+					changes.insert(key, false);
+				foreach(auto key, batch[2].toStringList())
+					changes.insert(key, true);
+			}
+			return changes;
+		};
+		QHash<QString, bool> expected;
+		expected.insert(QStringLiteral("10"), false);
+		expected.insert(QStringLiteral("11"), true);
+		expected.insert(QStringLiteral("12"), false);
+		QTRY_COMPARE(mergeBatches(), expected);
+
+		QTRY_VERIFY(caching->contains(10) && caching->contains(12) && !caching->contains(11));
+		QCOMPARE(caching->load(10), generateData(10));
+		QCOMPARE(caching->load(12), generateData(12));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void CachingDataStoreTest::testChangePayload()
+{
+	QVERIFY(caching);
+
+	try {
+		QSignalSpy payloadSpy(async, &AsyncDataStore::dataChangedPayload);
+
+		async->save<TestData>(TestData(12, QStringLiteral("payload"))).waitForFinished();
+		QTRY_VERIFY(!payloadSpy.isEmpty());
+
+		//the written data is passed along with the change
+		QJsonObject changedData;
+		foreach(auto batch, payloadSpy) {
+			if(batch[0].toInt() == qMetaTypeId<TestData>()) {
+				changedData = batch[3].toJsonObject();
+				QCOMPARE(batch[4].toULongLong(), async->origin());
+			}
+		}
+		QVERIFY(changedData.contains(QStringLiteral("12")));
+		QCOMPARE(async->deserialize<TestData>(changedData.value(QStringLiteral("12")).toObject()),
+				 TestData(12, QStringLiteral("payload")));
+
+		QTRY_COMPARE(caching->load(12).text, QStringLiteral("payload"));
+
+		//changes of other stores have a different origin
+		payloadSpy.clear();
+		caching->save(generateData(12));
+		QTRY_VERIFY(!payloadSpy.isEmpty());
+		QVERIFY(payloadSpy[0][4].toULongLong() != async->origin());
+		QVERIFY(payloadSpy[0][4].toULongLong() != 0);
+		QCOMPARE(async->load<TestData>(12).result(), generateData(12));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void CachingDataStoreTest::testKeyCache()
+{
+	try {
+		for(auto i = 20; i < 25; i++)
+			async->save<TestData>(generateData(i)).waitForFinished();
+		QTRY_VERIFY(caching->contains(24));//all change notifications have been delivered
+
+		CachingDataStore<TestData, int> bounded(CachingDataStoreBase::KeyCache, nullptr, true);
+		bounded.setCacheLimit(2);
+		QCOMPARE(bounded.cacheMode(), CachingDataStoreBase::KeyCache);
+		QCOMPARE(bounded.count(), 7);
+		QVERIFY(bounded.contains(22));
+		QVERIFY(!bounded.isCached(22));
+
+		//misses are loaded in the background, and the least recently used dataset is evicted
+		QCOMPARE(bounded.load(20), TestData());
+		QTRY_VERIFY(bounded.isCached(20));
+		QCOMPARE(bounded.load(20), generateData(20));
+		QCOMPARE(bounded.load(21), TestData());
+		QTRY_VERIFY(bounded.isCached(21));
+		QVERIFY(bounded.isCached(20));
+		QCOMPARE(bounded.load(22), TestData());
+		QTRY_VERIFY(bounded.isCached(22));
+		QVERIFY(!bounded.isCached(20));
+		QCOMPARE(bounded.load(21), generateData(21));
+		QCOMPARE(bounded.load(22), generateData(22));
+		QCOMPARE(bounded.load(77), TestData());
+
+		//prefetching skips unknown keys and reports the loaded datasets
+		bounded.setCacheLimit(10);
+		QSignalSpy changedSpy(&bounded, &CachingDataStoreBase::dataChanged);
+		bounded.prefetch({23, 24, 77});
+		QTRY_COMPARE(changedSpy.size(), 2);
+		QVERIFY(bounded.isCached(23));
+		QVERIFY(bounded.isCached(24));
+
+		//saved datasets are not evicted before they have been written
+		bounded.setCacheLimit(1);
+		bounded.save(generateData(30));
+		bounded.save(generateData(31));
+		bounded.save(generateData(32));
+		QVERIFY(bounded.isCached(30));
+		QVERIFY(bounded.isCached(31));
+		QVERIFY(bounded.isCached(32));
+		QCOMPARE(bounded.count(), 10);
+		QCOMPARE(bounded.load(31), generateData(31));
+		QTRY_COMPARE(bounded.isCached(30) + bounded.isCached(31) + bounded.isCached(32), 1);
+		QCOMPARE(async->count<TestData>().result(), 10);
+
+		//lazy stores load the keys and all datasets on demand, without blocking
+		CachingDataStore<TestData, int> lazy(CachingDataStoreBase::LazyCache, nullptr, true);
+		QSignalSpy keysSpy(&lazy, &CachingDataStoreBase::keysLoaded);
+		QVERIFY(!lazy.contains(20));
+		QVERIFY(keysSpy.wait());
+		QVERIFY(lazy.contains(20));
+		QCOMPARE(lazy.count(), 10);
+		QCOMPARE(keysSpy.size(), 1);
+		QVERIFY(lazy.loadAll().size() < 10);
+		QTRY_COMPARE(lazy.loadAll().size(), 10);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void CachingDataStoreTest::testSharedCache()
+{
+	QVERIFY(caching);
+
+	try {
+		QTRY_COMPARE(caching->count(), 10);
+
+		//the second store shares the already loaded data
+		CachingDataStore<TestData, int> second;
+		QSignalSpy loadSpy(&second, &CachingDataStoreBase::storeLoaded);
+		QVERIFY(loadSpy.wait());
+		QCOMPARE(loadSpy.size(), 1);
+		QCOMPARE(second.count(), 10);
+		QCOMPARE(second.load(22), generateData(22));
+
+		//changes made through one store are visible in all of them
+		QSignalSpy changedSpy(&second, &CachingDataStoreBase::dataChanged);
+		caching->save(generateData(40));
+		QCOMPARE(second.load(40), generateData(40));
+		QCOMPARE(changedSpy.size(), 1);
+		QCOMPARE(changedSpy[0][0].toString(), QStringLiteral("40"));
+
+		second.remove(40);
+		QVERIFY(!caching->contains(40));
+		QCOMPARE(caching->count(), 10);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void CachingDataStoreTest::testIndexes()
+{
+	QVERIFY(caching);
+
+	try {
+		QVERIFY(caching->addIndex("text"));
+		QVERIFY(caching->hasIndex("text"));
+		QVERIFY(!caching->addIndex("invalid"));
+		QVERIFY(!caching->hasIndex("invalid"));
+		QVERIFY(caching->sorted("invalid").isEmpty());
+
+		QCOMPARE(caching->sorted("text").toList(), QList<int>({10, 12, 20, 21, 22, 23, 24, 30, 31, 32}));
+		QCOMPARE(caching->lookup("text", QStringLiteral("21")).toList(), QList<int>({21}));
+		QCOMPARE(caching->range("text", QStringLiteral("20"), QStringLiteral("24")).toList(), QList<int>({20, 21, 22, 23, 24}));
+		QVERIFY(caching->range("text", QStringLiteral("24"), QStringLiteral("20")).isEmpty());
+
+		//local changes move single datasets
+		caching->save(TestData(21, QStringLiteral("99")));
+		QVERIFY(caching->lookup("text", QStringLiteral("21")).isEmpty());
+		QCOMPARE(caching->lookup("text", QStringLiteral("99")).toList(), QList<int>({21}));
+		caching->remove(10);
+		QCOMPARE(caching->sorted("text").toList(), QList<int>({12, 20, 22, 23, 24, 30, 31, 32, 21}));
+
+		//changes in the store as well
+		async->save<TestData>(TestData(50, QStringLiteral("00")));
+		QTRY_COMPARE(caching->sorted("text").toList(), QList<int>({50, 12, 20, 22, 23, 24, 30, 31, 32, 21}));
+
+		//indexes are shared
+		CachingDataStore<TestData, int> second;
+		QVERIFY(second.hasIndex("text"));
+		QCOMPARE(second.range("text", QStringLiteral("0"), QStringLiteral("2")).toList(), QList<int>({50, 12}));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void CachingDataStoreTest::testSnapshot()
+{
+	QTemporaryDir tDir;
+	auto localStore = new MockLocalStore();
+	localStore->enabled = true;
+	Setup setup;
+	setup.setLocalStore(localStore)
+		 .setStateHolder(new MockStateHolder())
+		 .setRemoteConnector(new MockRemoteConnector())
+		 .setDataMerger(new MockDataMerger())
+		 .setEncryptor(new MockEncryptor())
+		 .setLocalDir(tDir.path())
+		 .setCacheSnapshots(true);
+	setup.create(QStringLiteral("snapshots"));
+
+	try {
+		AsyncDataStore snapAsync(QStringLiteral("snapshots"));
+		for(auto i = 0; i < 5; i++)
+			snapAsync.save<TestData>(generateData(i)).waitForFinished();
+
+		auto first = new CachingDataStore<TestData, int>(QStringLiteral("snapshots"), nullptr, true);
+		QCOMPARE(first->count(), 5);
+		QVERIFY(first->writeSnapshot());
+		delete first;
+
+		//a silent change is not seen if the snapshot is used, logged ones are
+		{
+			QMutexLocker _(&localStore->mutex);
+			localStore->pseudoStore.insert(generateKey(1), QJsonObject {
+											   {QStringLiteral("id"), 1},
+											   {QStringLiteral("text"), QStringLiteral("silent")}
+										   });
+		}
+		snapAsync.save<TestData>(generateData(5)).waitForFinished();
+		snapAsync.remove<TestData>(0).waitForFinished();
+
+		auto second = new CachingDataStore<TestData, int>(QStringLiteral("snapshots"), nullptr, true);
+		QCOMPARE(second->count(), 5);
+		QCOMPARE(second->load(1), generateData(1));
+		QCOMPARE(second->load(5), generateData(5));
+		QVERIFY(!second->contains(0));
+		delete second;
+
+		//an outdated snapshot is ignored
+		{
+			QMutexLocker _(&localStore->mutex);
+			localStore->horizon = localStore->sequence;
+		}
+		CachingDataStore<TestData, int> third(QStringLiteral("snapshots"));
+		QSignalSpy loadSpy(&third, &CachingDataStoreBase::storeLoaded);
+		QVERIFY(loadSpy.wait());
+		QCOMPARE(third.count(), 5);
+		QCOMPARE(third.load(1).text, QStringLiteral("silent"));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+
+	Setup::removeSetup(QStringLiteral("snapshots"), true);
+}
+
+void CachingDataStoreTest::testProgressive()
+{
+	try {
+		auto keys = async->keys<TestData>().result();
+		auto total = keys.size();
+		QVERIFY(total > 3);
+
+		CachingDataStore<TestData, int> progressive(CachingDataStoreBase::ProgressiveCache);
+		QCOMPARE(progressive.cacheMode(), CachingDataStoreBase::ProgressiveCache);
+		progressive.setLoadChunkSize(3);
+		QSignalSpy progressSpy(&progressive, &CachingDataStoreBase::loadProgress);
+		QSignalSpy loadSpy(&progressive, &CachingDataStoreBase::storeLoaded);
+		QSignalSpy changedSpy(&progressive, &CachingDataStoreBase::dataChanged);
+
+		//the first chunk is available before the store has been loaded
+		QVERIFY(progressSpy.wait());
+		QCOMPARE(progressSpy[0][0].toInt(), 3);
+		QCOMPARE(progressSpy[0][1].toInt(), total);
+		QCOMPARE(progressive.count(), 3);
+		QVERIFY(!progressive.isLoaded());
+		QCOMPARE(loadSpy.size(), 0);
+
+		//datasets that are not loaded yet are loaded ahead of the others
+		auto missing = -1;
+		foreach(auto key, keys) {
+			auto rKey = CachingDataStore<TestData, int>::toKey(key);
+			if(!progressive.contains(rKey))
+				missing = rKey;
+		}
+		QVERIFY(missing >= 0);
+		QCOMPARE(progressive.load(missing), TestData());
+		QTRY_VERIFY(progressive.contains(missing));
+		QCOMPARE(progressive.load(missing), async->load<TestData>(missing).result());
+
+		QTRY_COMPARE(loadSpy.size(), 1);
+		QCOMPARE(progressive.count(), total);
+		QCOMPARE(progressSpy.last()[0].toInt(), total);
+		QCOMPARE(progressSpy.last()[1].toInt(), total);
+		//every dataset is reported once, including the explicitly loaded one
+		QCOMPARE(changedSpy.size(), total);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void CachingDataStoreTest::testWriteBehind()
+{
+	QVERIFY(caching);
+
+	try {
+		QSignalSpy asyncSpy(async, &AsyncDataStore::dataChanged);
+
+		//repeated saves are written once, after the delay
+		caching->setWriteDelay(200);
+		caching->setMaxWriteLatency(60000);
+		for(auto i = 0; i < 5; i++)
+			caching->save(TestData(60, QString::number(i)));
+		QCOMPARE(caching->load(60).text, QStringLiteral("4"));
+		QVERIFY(!async->keys<TestData>().result().contains(QStringLiteral("60")));
+		QTRY_COMPARE(asyncSpy.size(), 1);
+		QCOMPARE(async->load<TestData>(60).result().text, QStringLiteral("4"));
+
+		//the maximum latency wins over the delay
+		caching->setWriteDelay(60000);
+		caching->setMaxWriteLatency(200);
+		caching->save(generateData(61));
+		QTRY_COMPARE(asyncSpy.size(), 2);
+		QCOMPARE(async->load<TestData>(61).result(), generateData(61));
+
+		//flushing writes immediately
+		caching->setMaxWriteLatency(60000);
+		caching->save(generateData(62));
+		QVERIFY(!asyncSpy.wait(500));
+		caching->flush();
+		QTRY_COMPARE(asyncSpy.size(), 3);
+		QCOMPARE(async->load<TestData>(62).result(), generateData(62));
+
+		//removing drops the waiting write
+		caching->save(generateData(63));
+		caching->remove(63);
+		caching->setWriteDelay(0);
+		QVERIFY(!async->keys<TestData>().result().contains(QStringLiteral("63")));
 	} catch(QException &e) {
 		QFAIL(e.what());
 	}
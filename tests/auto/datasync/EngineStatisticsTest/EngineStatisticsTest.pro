@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# Project created by QtCreator 2026-10-19T10:12:41
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+include(../tests.pri)
+
+TARGET = tst_enginestatistics
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += tst_enginestatistics.cpp
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
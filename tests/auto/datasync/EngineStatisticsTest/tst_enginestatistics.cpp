@@ -0,0 +1,265 @@
+#include <QString>
+#include <QtTest>
+#include <QCoreApplication>
+#include "tst.h"
+using namespace QtDataSync;
+
+class EngineStatisticsTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void testLatencyHistograms();
+	void testRequestLimit();
+	void testDelayRequests();
+	void testCoalescing();
+	void testLanes();
+	void testCancel();
+
+private:
+	MockLocalStore *store;
+	AsyncDataStore *async;
+	SyncController *controller;
+};
+
+static const int RequestLimit = 3;
+
+void EngineStatisticsTest::initTestCase()
+{
+#ifdef Q_OS_LINUX
+	Q_ASSERT(qgetenv("LD_PRELOAD").contains("Qt5DataSync"));
+#endif
+
+	tst_init();
+
+	Setup setup;
+	mockSetup(setup);
+	setup.setRequestLimit(RequestLimit);
+	store = static_cast<MockLocalStore*>(setup.localStore());
+	store->enabled = true;
+	setup.create();
+
+	async = new AsyncDataStore(this);
+	controller = new SyncController(this);
+}
+
+void EngineStatisticsTest::cleanupTestCase()
+{
+	delete controller;
+	delete async;
+	Setup::removeSetup(Setup::DefaultSetup);
+}
+
+void EngineStatisticsTest::testLatencyHistograms()
+{
+	store->mutex.lock();
+	store->pseudoStore = generateDataJson(0, 10);
+	store->mutex.unlock();
+
+	auto before = controller->engineStatistics();
+
+	async->count<TestData>().waitForFinished();
+	async->keys<TestData>().waitForFinished();
+	async->save<TestData>(generateData(42)).waitForFinished();
+
+	auto after = controller->engineStatistics();
+	QCOMPARE(after.queuedRequests, 0);
+	QCOMPARE(after.activeRequests, 0);
+	QVERIFY(after.peakQueuedRequests >= 1);
+
+	auto bucketCount = EngineStatistics::latencyBuckets().size() + 1;
+	foreach(auto type, QByteArrayList({"Count", "Keys", "Save"})) {
+		auto histogram = after.latencyHistograms.value(type);
+		QCOMPARE(histogram.size(), bucketCount);
+		quint64 total = 0;
+		foreach(auto value, histogram)
+			total += value;
+		quint64 totalBefore = 0;
+		foreach(auto value, before.latencyHistograms.value(type))
+			totalBefore += value;
+		QCOMPARE(total, totalBefore + 1);
+	}
+}
+
+void EngineStatisticsTest::testRequestLimit()
+{
+	auto rejectedBefore = controller->engineStatistics().rejectedRequests;
+
+	//block the engine inside the first request, so all further ones stay queued
+	store->mutex.lock();
+	QList<GenericTask<int>> tasks;
+	tasks.append(async->count<TestData>());
+	QTRY_COMPARE(controller->engineStatistics().activeRequests, 1);
+	for(auto i = 0; i < RequestLimit; i++)
+		tasks.append(async->count<TestData>());
+	QCOMPARE(controller->engineStatistics().queuedRequests, RequestLimit);
+
+	auto rejected = async->count<TestData>();
+	store->mutex.unlock();
+
+	try {
+		rejected.result();
+		QFAIL("Expected EngineOverloadedException");
+	} catch(EngineOverloadedException &) {
+		//expected
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+	QCOMPARE(controller->engineStatistics().rejectedRequests, rejectedBefore + 1);
+
+	try {
+		foreach(auto task, tasks)
+			task.result();
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void EngineStatisticsTest::testDelayRequests()
+{
+	QTemporaryDir tDir;
+	auto localStore = new MockLocalStore();
+	localStore->enabled = true;
+	Setup setup;
+	setup.setLocalStore(localStore)
+		 .setStateHolder(new MockStateHolder())
+		 .setRemoteConnector(new MockRemoteConnector())
+		 .setDataMerger(new MockDataMerger())
+		 .setEncryptor(new MockEncryptor())
+		 .setLocalDir(tDir.path())
+		 .setRequestLimit(1, Setup::DelayRequests);
+	setup.create(QStringLiteral("delay"));
+
+	{
+		AsyncDataStore delayAsync(QStringLiteral("delay"));
+		SyncController delayController(QStringLiteral("delay"));
+
+		//block the engine inside the first request, so all further ones stay queued
+		localStore->mutex.lock();
+		auto blocker = delayAsync.count<TestData>();
+		QTRY_COMPARE(delayController.engineStatistics().activeRequests, 1);
+		auto queued = delayAsync.count<TestData>();
+
+		//creating the request does not block, it is reported as paused instead
+		auto delayed = delayAsync.count<TestData>();
+		QVERIFY(!queued.isPaused());
+		QVERIFY(delayed.isPaused());
+		auto stats = delayController.engineStatistics();
+		QCOMPARE(stats.queuedRequests, 2);
+		QCOMPARE(stats.delayedRequests, 1ull);
+		QCOMPARE(stats.rejectedRequests, 0ull);
+		localStore->mutex.unlock();
+
+		try {
+			blocker.result();
+			queued.result();
+			delayed.result();
+		} catch(QException &e) {
+			QFAIL(e.what());
+		}
+		QVERIFY(!delayed.isPaused());
+	}
+
+	Setup::removeSetup(QStringLiteral("delay"), true);
+}
+
+void EngineStatisticsTest::testCoalescing()
+{
+	store->mutex.lock();
+	store->pseudoStore = generateDataJson(0, 10);
+	auto before = controller->engineStatistics();
+
+	//block the engine inside the first request, so all further ones stay queued
+	auto blocker = async->count<TestData>();
+	QTRY_COMPARE(controller->engineStatistics().activeRequests, 1);
+
+	auto load1 = async->load<TestData>(5);
+	auto load2 = async->load<TestData>(5);
+	QList<GenericTask<void>> saves;
+	for(auto i = 0; i < 3; i++)
+		saves.append(async->save<TestData>({42, QString::number(i)}));
+	auto after = controller->engineStatistics();
+	QCOMPARE(after.queuedRequests, 3);
+	QCOMPARE(after.coalescedRequests, before.coalescedRequests + 2);
+	store->mutex.unlock();
+
+	try {
+		blocker.result();
+		QCOMPARE(load1.result(), generateData(5));
+		QCOMPARE(load2.result(), generateData(5));
+		foreach(auto task, saves)
+			task.waitForFinished();
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+
+	store->mutex.lock();
+	QCOMPARE(store->pseudoStore.value(generateKey(42))[QStringLiteral("text")].toString(), QStringLiteral("2"));
+	store->mutex.unlock();
+}
+
+void EngineStatisticsTest::testLanes()
+{
+	auto countWaits = [](const EngineStatistics &stats, const QByteArray &lane) {
+		quint64 total = 0;
+		foreach(auto value, stats.laneWaitHistograms.value(lane))
+			total += value;
+		return total;
+	};
+
+	store->mutex.lock();
+	store->pseudoStore = generateDataJson(0, 10);
+	store->mutex.unlock();
+
+	auto before = controller->engineStatistics();
+
+	AsyncDataStore background;
+	background.setRequestPriority(AsyncDataStore::BackgroundPriority);
+	QCOMPARE(background.requestPriority(), AsyncDataStore::BackgroundPriority);
+	try {
+		QCOMPARE(background.load<TestData>(3).result(), generateData(3));
+		//writes are always scheduled as interactive requests
+		background.save<TestData>(generateData(43)).waitForFinished();
+		QCOMPARE(async->count<TestData>().result(), 11);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+
+	auto after = controller->engineStatistics();
+	QCOMPARE(countWaits(after, "Background"), countWaits(before, "Background") + 1);
+	QCOMPARE(countWaits(after, "Interactive"), countWaits(before, "Interactive") + 2);
+}
+
+void EngineStatisticsTest::testCancel()
+{
+	store->mutex.lock();
+	store->pseudoStore = generateDataJson(0, 10);
+	auto before = controller->engineStatistics();
+
+	//block the engine inside the first request, so all further ones stay queued
+	auto blocker = async->count<TestData>();
+	QTRY_COMPARE(controller->engineStatistics().activeRequests, 1);
+
+	auto canceled = async->loadAll<TestData>();
+	auto kept = async->load<TestData>(4);
+	canceled.cancel();
+	store->mutex.unlock();
+
+	try {
+		QCOMPARE(blocker.result(), 10);
+		QCOMPARE(kept.result(), generateData(4));
+		canceled.waitForFinished();
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+	QVERIFY(canceled.isCanceled());
+	QCOMPARE(canceled.resultCount(), 0);
+	QCOMPARE(controller->engineStatistics().canceledRequests, before.canceledRequests + 1);
+}
+
+QTEST_MAIN(EngineStatisticsTest)
+
+#include "tst_enginestatistics.moc"
@@ -21,14 +21,19 @@ private Q_SLOTS:
 	void testKeys();
 	void testLoadAll_data();
 	void testLoadAll();
+	void testLoadAllProjected_data();
+	void testLoadAllProjected();
 	void testLoad_data();
 	void testLoad();
+	void testLoadMany_data();
+	void testLoadMany();
 	void testSave_data();
 	void testSave();
 	void testRemove_data();
 	void testRemove();
 	void testSearch_data();
 	void testSearch();
+	void testChangesSince();
 	void testIterate_data();
 	void testIterate();
 
@@ -177,6 +182,65 @@ void LocalStoreTest::testLoadAll()
 	}
 }
 
+void LocalStoreTest::testLoadAllProjected_data()
+{
+	QTest::addColumn<DataSet>("data");
+	QTest::addColumn<QStringList>("properties");
+	QTest::addColumn<bool>("storeFails");
+	QTest::addColumn<bool>("shouldFail");
+
+	QTest::newRow("emptyData") << DataSet()
+							   << QStringList{QStringLiteral("text")}
+							   << false
+							   << false;
+	QTest::newRow("singleProperty") << generateDataJson(10, 20)
+									<< QStringList{QStringLiteral("text")}
+									<< false
+									<< false;
+	QTest::newRow("allProperties") << generateDataJson(10, 20)
+								   << QStringList{QStringLiteral("id"), QStringLiteral("text")}
+								   << false
+								   << false;
+	QTest::newRow("invalidProperty") << generateDataJson(10, 20)
+									 << QStringList{QStringLiteral("baum")}
+									 << false
+									 << true;
+	QTest::newRow("invalidData") << DataSet()
+								 << QStringList{QStringLiteral("id")}
+								 << true
+								 << true;
+}
+
+void LocalStoreTest::testLoadAllProjected()
+{
+	QFETCH(DataSet, data);
+	QFETCH(QStringList, properties);
+	QFETCH(bool, storeFails);
+	QFETCH(bool, shouldFail);
+
+	store->mutex.lock();
+	store->pseudoStore = data;
+	store->failCount = storeFails ? 1 : 0;
+	store->mutex.unlock();
+
+	try {
+		auto task = async->loadAllProjected<TestData>(properties);
+		auto res = task.result();
+		QVERIFY(!shouldFail);
+		QCOMPARE(res.size(), data.size());
+		QStringList texts;
+		foreach(auto value, res) {
+			QCOMPARE(value.keys(), properties);
+			if(value.contains(QStringLiteral("id")))
+				QCOMPARE(value.value(QStringLiteral("id")).userType(), (int)QMetaType::Int);
+			texts.append(value.value(QStringLiteral("text")).toString());
+		}
+		QLISTCOMPARE(texts, generateDataKeys(10, 10 + data.size()));
+	} catch(QException &e) {
+		QVERIFY2(shouldFail, e.what());
+	}
+}
+
 void LocalStoreTest::testLoad_data()
 {
 	QTest::addColumn<DataSet>("data");
@@ -220,6 +284,55 @@ void LocalStoreTest::testLoad()
 	}
 }
 
+void LocalStoreTest::testLoadMany_data()
+{
+	QTest::addColumn<DataSet>("data");
+	QTest::addColumn<QStringList>("keys");
+	QTest::addColumn<QList<TestData>>("result");
+	QTest::addColumn<bool>("shouldFail");
+
+	QTest::newRow("emptyKeys") << generateDataJson(10, 20)
+							   << QStringList()
+							   << QList<TestData>()
+							   << false;
+	QTest::newRow("simpleData") << generateDataJson(10, 110)
+								<< generateDataKeys(20, 90)
+								<< generateData(20, 90)
+								<< false;
+	QTest::newRow("missingData") << generateDataJson(10, 20)
+								 << generateDataKeys(15, 25)
+								 << generateData(15, 20)
+								 << false;
+	QTest::newRow("invalidData") << generateDataJson(10, 20)
+								 << generateDataKeys(10, 20)
+								 << QList<TestData>()
+								 << true;
+}
+
+void LocalStoreTest::testLoadMany()
+{
+	QFETCH(DataSet, data);
+	QFETCH(QStringList, keys);
+	QFETCH(QList<TestData>, result);
+	QFETCH(bool, shouldFail);
+
+	store->mutex.lock();
+	store->pseudoStore = data;
+	store->failCount = shouldFail ? 1 : 0;
+	store->mutex.unlock();
+
+	try {
+		auto task = async->loadMany<TestData>(keys);
+		auto res = task.result();
+		QVERIFY(!shouldFail);
+		QCOMPARE(res.size(), result.size());
+		foreach(auto value, result)
+			QCOMPARE(res.value(QString::number(value.id)), value);
+	} catch(QException &e) {
+		QVERIFY2(shouldFail, e.what());
+	}
+}
+
 void LocalStoreTest::testSave_data()
 {
 	QTest::addColumn<TestData>("data");
@@ -355,19 +468,82 @@ void LocalStoreTest::testSearch()
 	}
 }
 
+void LocalStoreTest::testChangesSince()
+{
+	store->mutex.lock();
+	store->pseudoStore = generateDataJson(0, 10);
+	store->failCount = 0;
+	store->mutex.unlock();
+
+	try {
+		auto start = async->changesSince<TestData>(0).result();
+		QVERIFY(start.complete);
+
+		foreach(auto data, generateData(0, 5))
+			async->save<TestData>(data).waitForFinished();
+		async->remove<TestData>(7).waitForFinished();
+		async->remove<TestData>(42).waitForFinished();//nothing removed, nothing logged
+		auto first = async->changesSince<TestData>(start.sequence).result();
+		QVERIFY(first.complete);
+		QCOMPARE(first.sequence, start.sequence + 6);
+		QLISTCOMPARE(first.changed, generateDataKeys(0, 5));
+		QLISTCOMPARE(first.deleted, generateDataKeys(7, 8));
+
+		//only the latest change of a dataset is reported
+		async->remove<TestData>(3).waitForFinished();
+		async->save<TestData>(generateData(7)).waitForFinished();
+		auto second = async->changesSince<TestData>(first.sequence).result();
+		QVERIFY(second.complete);
+		QCOMPARE(second.sequence, first.sequence + 2);
+		QLISTCOMPARE(second.changed, generateDataKeys(7, 8));
+		QLISTCOMPARE(second.deleted, generateDataKeys(3, 4));
+
+		auto none = async->changesSince<TestData>(second.sequence).result();
+		QVERIFY(none.complete);
+		QCOMPARE(none.sequence, second.sequence);
+		QVERIFY(none.changed.isEmpty());
+		QVERIFY(none.deleted.isEmpty());
+
+		//after a reset, older sequences cannot be caught up anymore
+		store->resetStore();
+		auto reset = async->changesSince<TestData>(first.sequence).result();
+		QVERIFY(!reset.complete);
+		QCOMPARE(reset.sequence, second.sequence);
+		QVERIFY(async->changesSince<TestData>(reset.sequence).result().complete);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+
+	store->mutex.lock();
+	store->failCount = 1;
+	store->mutex.unlock();
+	try {
+		async->changesSince<TestData>(0).result();
+		QFAIL("No exception thrown");
+	} catch(QException &) {}
+}
+
 void LocalStoreTest::testIterate_data()
 {
 	QTest::addColumn<DataSet>("data");
+	QTest::addColumn<int>("window");
 	QTest::addColumn<QList<TestData>>("result");
 	QTest::addColumn<bool>("shouldFail");
 
 	QTest::newRow("emptyData") << DataSet()
+							   << 100
 							   << QList<TestData>()
 							   << false;
 	QTest::newRow("simpleData") << generateDataJson(5, 55)
+								<< 100
 								<< generateData(5, 55)
 								<< false;
+	QTest::newRow("windowedData") << generateDataJson(5, 55)
+								  << 7
+								  << generateData(5, 55)
+								  << false;
 	QTest::newRow("invalidData") << generateDataJson(10, 20)
+								 << 100
 								 << QList<TestData>()
 								 << true;
 }
@@ -375,6 +551,7 @@ void LocalStoreTest::testIterate_data()
 void LocalStoreTest::testIterate()
 {
 	QFETCH(DataSet, data);
+	QFETCH(int, window);
 	QFETCH(QList<TestData>, result);
 	QFETCH(bool, shouldFail);
 
@@ -383,6 +560,7 @@ void LocalStoreTest::testIterate()
 	store->failCount = shouldFail ? 1 : 0;
 	store->mutex.unlock();
 
+	async->setIterateWindow(window);
 	QSignalSpy spy(this, &LocalStoreTest::unlock);
 
 	async->iterate<TestData>([=, &result](TestData data){
@@ -18,10 +18,14 @@ private Q_SLOTS:
 	void testSaveAndLoad();
 	void testLoadAll();
 	void testLoadInvalid();
+	void testLoadMany();
+	void testLoadAllProjected();
 	void testSearch_data();
 	void testSearch();
 	void testRemove_data();
 	void testRemove();
+	void testChangesSince();
+	void testShardWrites();
 
 	void testLoadAllKeys();
 	void testResetStore();
@@ -30,6 +34,21 @@ private:
 	SqlLocalStore *store;
 };
 
+class ShardSaveRunnable : public QRunnable
+{
+public:
+	ShardSaveRunnable(SqlLocalStore *store, Defaults *defaults, int offset, int count, QAtomicInt *failures);
+
+	void run() override;
+
+private:
+	SqlLocalStore *store;
+	Defaults *defaults;
+	int offset;
+	int count;
+	QAtomicInt *failures;
+};
+
 void SqlStoreTest::initTestCase()
 {
 #ifdef Q_OS_LINUX
@@ -94,31 +113,33 @@ void SqlStoreTest::testSaveAndLoad()
 void SqlStoreTest::testLoadAll()
 {
 	QSignalSpy completedSpy(store, &SqlLocalStore::requestCompleted);
+	QSignalSpy resultSpy(store, &SqlLocalStore::requestResultReady);
 	QSignalSpy failedSpy(store, &SqlLocalStore::requestFailed);
 
-	auto keyList = QJsonArray::fromStringList(generateDataKeys(420, 423));
+	auto keyList = generateDataKeys(420, 423);
 	auto dataList = dataListJson(generateDataJson(420, 423));
 
 	auto id = 1ull;
 	store->count(id, "TestData");
 	QCOMPARE(failedSpy.size(), 0);
-	QCOMPARE(completedSpy.size(), 1);
-	QCOMPARE(completedSpy[0][0].toULongLong(), id);
-	QCOMPARE(completedSpy[0][1].value<QJsonValue>().toInt(), 3);
+	QCOMPARE(completedSpy.size(), 0);
+	QCOMPARE(resultSpy.size(), 1);
+	QCOMPARE(resultSpy[0][0].toULongLong(), id);
+	QCOMPARE(resultSpy[0][1].value<QVariant>().toInt(), 3);
 
 	id = 2ull;
 	failedSpy.clear();
-	completedSpy.clear();
+	resultSpy.clear();
 	store->keys(id, "TestData");
 	QCOMPARE(failedSpy.size(), 0);
-	QCOMPARE(completedSpy.size(), 1);
-	QCOMPARE(completedSpy[0][0].toULongLong(), id);
-	QLISTCOMPARE(completedSpy[0][1].value<QJsonValue>().toArray().toVariantList(),
-				 keyList.toVariantList());
+	QCOMPARE(completedSpy.size(), 0);
+	QCOMPARE(resultSpy.size(), 1);
+	QCOMPARE(resultSpy[0][0].toULongLong(), id);
+	QLISTCOMPARE(resultSpy[0][1].value<QVariant>().toStringList(), keyList);
 
 	id = 3ull;
 	failedSpy.clear();
-	completedSpy.clear();
+	resultSpy.clear();
 	store->loadAll(id, "TestData");
 	QCOMPARE(failedSpy.size(), 0);
 	QCOMPARE(completedSpy.size(), 1);
@@ -140,6 +161,43 @@ void SqlStoreTest::testLoadInvalid()
 	QCOMPARE(failedSpy[0][0].toULongLong(), 1ull);
 }
 
+void SqlStoreTest::testLoadMany()
+{
+	QSignalSpy completedSpy(store, &SqlLocalStore::requestCompleted);
+	QSignalSpy failedSpy(store, &SqlLocalStore::requestFailed);
+
+	auto keys = generateDataKeys(421, 425);
+	QJsonObject data;
+	auto dataSet = generateDataJson(421, 423);
+	for(auto it = dataSet.constBegin(); it != dataSet.constEnd(); it++)
+		data.insert(it.key().second, it.value());
+
+	auto id = 1ull;
+	store->loadMany(id, "TestData", keys, "id");
+	QCOMPARE(failedSpy.size(), 0);
+	QCOMPARE(completedSpy.size(), 1);
+	QCOMPARE(completedSpy[0][0].toULongLong(), id);
+	QCOMPARE(completedSpy[0][1].value<QJsonValue>().toObject(), data);
+}
+
+void SqlStoreTest::testLoadAllProjected()
+{
+	QSignalSpy completedSpy(store, &SqlLocalStore::requestCompleted);
+	QSignalSpy failedSpy(store, &SqlLocalStore::requestFailed);
+
+	QJsonArray dataList;
+	foreach(auto text, generateDataKeys(420, 423))
+		dataList.append(QJsonObject {{QStringLiteral("text"), text}});
+
+	auto id = 1ull;
+	store->loadAllProjected(id, "TestData", {QStringLiteral("text"), QStringLiteral("missing")});
+	QCOMPARE(failedSpy.size(), 0);
+	QCOMPARE(completedSpy.size(), 1);
+	QCOMPARE(completedSpy[0][0].toULongLong(), id);
+	QLISTCOMPARE(completedSpy[0][1].value<QJsonValue>().toArray().toVariantList(),
+				 dataList.toVariantList());
+}
+
 void SqlStoreTest::testSearch_data()
 {
 	QTest::addColumn<QString>("query");
@@ -190,15 +248,113 @@ void SqlStoreTest::testRemove()
 	QFETCH(ObjectKey, key);
 	QFETCH(bool, changed);
 
-	QSignalSpy completedSpy(store, &SqlLocalStore::requestCompleted);
+	QSignalSpy resultSpy(store, &SqlLocalStore::requestResultReady);
 	QSignalSpy failedSpy(store, &SqlLocalStore::requestFailed);
 
 	auto id = 1ull;
 	store->remove(id, key, "id");
 	QCOMPARE(failedSpy.size(), 0);
-	QCOMPARE(completedSpy.size(), 1);
-	QCOMPARE(completedSpy[0][0].toULongLong(), id);
-	QCOMPARE(completedSpy[0][1].value<QJsonValue>().toBool(), changed);
+	QCOMPARE(resultSpy.size(), 1);
+	QCOMPARE(resultSpy[0][0].toULongLong(), id);
+	QCOMPARE(resultSpy[0][1].value<QVariant>().toBool(), changed);
+}
+
+void SqlStoreTest::testChangesSince()
+{
+	QSignalSpy resultSpy(store, &SqlLocalStore::requestResultReady);
+	QSignalSpy failedSpy(store, &SqlLocalStore::requestFailed);
+
+	auto id = 1ull;
+	store->changesSince(id, "TestData", 0);
+	QCOMPARE(failedSpy.size(), 0);
+	QCOMPARE(resultSpy.size(), 1);
+	QCOMPARE(resultSpy[0][0].toULongLong(), id);
+	auto base = resultSpy[0][1].value<QVariant>().value<ChangeSet>();
+	QVERIFY(base.complete);
+
+	store->save(2ull, generateKey(420), generateDataJson(420), "id");
+	store->save(3ull, generateKey(500), generateDataJson(500), "id");
+	QCOMPARE(failedSpy.size(), 0);
+
+	id = 4ull;
+	resultSpy.clear();
+	store->changesSince(id, "TestData", base.sequence);
+	QCOMPARE(failedSpy.size(), 0);
+	QCOMPARE(resultSpy.size(), 1);
+	QCOMPARE(resultSpy[0][0].toULongLong(), id);
+	auto changes = resultSpy[0][1].value<QVariant>().value<ChangeSet>();
+	QVERIFY(changes.complete);
+	QCOMPARE(changes.sequence, base.sequence + 2);
+	QCOMPARE(changes.changed, QStringList({QStringLiteral("420"), QStringLiteral("500")}));
+	QVERIFY(changes.deleted.isEmpty());
+
+	store->remove(5ull, generateKey(500), "id");
+	QCOMPARE(failedSpy.size(), 0);
+
+	id = 6ull;
+	resultSpy.clear();
+	store->changesSince(id, "TestData", changes.sequence);
+	QCOMPARE(failedSpy.size(), 0);
+	QCOMPARE(resultSpy.size(), 1);
+	QCOMPARE(resultSpy[0][0].toULongLong(), id);
+	changes = resultSpy[0][1].value<QVariant>().value<ChangeSet>();
+	QVERIFY(changes.complete);
+	QCOMPARE(changes.sequence, base.sequence + 3);
+	QVERIFY(changes.changed.isEmpty());
+	QCOMPARE(changes.deleted, QStringList(QStringLiteral("500")));
+
+	//other types are not reported, but share the sequence
+	id = 7ull;
+	resultSpy.clear();
+	store->changesSince(id, "Baum", base.sequence);
+	QCOMPARE(failedSpy.size(), 0);
+	QCOMPARE(resultSpy.size(), 1);
+	changes = resultSpy[0][1].value<QVariant>().value<ChangeSet>();
+	QCOMPARE(changes.sequence, base.sequence + 3);
+	QVERIFY(changes.changed.isEmpty());
+	QVERIFY(changes.deleted.isEmpty());
+}
+
+void SqlStoreTest::testShardWrites()
+{
+	static const int Shards = 4;
+	static const int SavesPerShard = 50;
+
+	//separate database, so the data of the other tests is not affected
+	QTemporaryDir dir;
+	Defaults defaults(QStringLiteral("shards"), QDir(dir.path()), {});
+	QAtomicInt failures;
+
+	//like in the engine, the shards are created after the first store has created the tables
+	QScopedPointer<LocalStore> shard(store->createShard(nullptr));
+	shard->initialize(&defaults);
+
+	//every shard runs on it's own thread, with it's own connection to the same database
+	QThreadPool pool;
+	pool.setMaxThreadCount(Shards);
+	for(auto i = 0; i < Shards; i++)
+		pool.start(new ShardSaveRunnable(store, &defaults, 1000 + i * SavesPerShard, SavesPerShard, &failures));
+	pool.waitForDone();
+	QCOMPARE(failures.load(), 0);
+
+	QSignalSpy resultSpy(shard.data(), &LocalStore::requestResultReady);
+	QSignalSpy failedSpy(shard.data(), &LocalStore::requestFailed);
+
+	shard->count(1ull, "TestData");
+	QCOMPARE(failedSpy.size(), 0);
+	QCOMPARE(resultSpy.size(), 1);
+	QCOMPARE(resultSpy[0][1].value<QVariant>().toInt(), Shards * SavesPerShard);
+
+	//every save got it's own change log entry
+	resultSpy.clear();
+	shard->changesSince(2ull, "TestData", 0);
+	QCOMPARE(failedSpy.size(), 0);
+	QCOMPARE(resultSpy.size(), 1);
+	auto changes = resultSpy[0][1].value<QVariant>().value<ChangeSet>();
+	QVERIFY(changes.complete);
+	QCOMPARE(changes.sequence, (quint64)(Shards * SavesPerShard));
+	QCOMPARE(changes.changed.size(), Shards * SavesPerShard);
+	shard->finalize();
 }
 
 void SqlStoreTest::testLoadAllKeys()
@@ -219,15 +375,49 @@ void SqlStoreTest::testResetStore()
 {
 	store->resetStore();
 
-	QSignalSpy completedSpy(store, &SqlLocalStore::requestCompleted);
+	QSignalSpy resultSpy(store, &SqlLocalStore::requestResultReady);
 	QSignalSpy failedSpy(store, &SqlLocalStore::requestFailed);
 
 	auto id = 1ull;
 	store->count(id, "TestData");
 	QCOMPARE(failedSpy.size(), 0);
-	QCOMPARE(completedSpy.size(), 1);
-	QCOMPARE(completedSpy[0][0].toULongLong(), id);
-	QCOMPARE(completedSpy[0][1].value<QJsonValue>().toInt(), 0);
+	QCOMPARE(resultSpy.size(), 1);
+	QCOMPARE(resultSpy[0][0].toULongLong(), id);
+	QCOMPARE(resultSpy[0][1].value<QVariant>().toInt(), 0);
+
+	//changes from before the reset cannot be caught up with
+	id = 2ull;
+	resultSpy.clear();
+	store->changesSince(id, "TestData", 0);
+	QCOMPARE(failedSpy.size(), 0);
+	QCOMPARE(resultSpy.size(), 1);
+	auto changes = resultSpy[0][1].value<QVariant>().value<ChangeSet>();
+	QVERIFY(!changes.complete);
+	QVERIFY(changes.changed.isEmpty());
+	QVERIFY(changes.deleted.isEmpty());
+}
+
+ShardSaveRunnable::ShardSaveRunnable(SqlLocalStore *store, Defaults *defaults, int offset, int count, QAtomicInt *failures) :
+	QRunnable(),
+	store(store),
+	defaults(defaults),
+	offset(offset),
+	count(count),
+	failures(failures)
+{}
+
+void ShardSaveRunnable::run()
+{
+	QScopedPointer<LocalStore> shard(store->createShard(nullptr));
+	shard->initialize(defaults);
+	QObject::connect(shard.data(), &LocalStore::requestFailed, [this](quint64, const QString &error){
+		qWarning() << error;
+		failures->ref();
+	});
+
+	for(auto i = offset; i < offset + count; i++)
+		shard->save(i, generateKey(i), generateDataJson(i), "id");
+	shard->finalize();
 }
 
 QTEST_MAIN(SqlStoreTest)
@@ -6,7 +6,9 @@ SUBDIRS += \
 	SqlStoreTest \
     ChangeControllerTest \
     CachingDataStoreTest \
+    CachingDataStoreModelTest \
     SqlStateHolderTest \
     WsRemoteConnectorTest \
     SetupTest \
-    TinyAesEncryptorTest
+    TinyAesEncryptorTest \
+    EngineStatisticsTest
@@ -1,13 +1,17 @@
 #include "mocklocalstore.h"
 
 #include <QJsonArray>
+#include <changeset.h>
 
 MockLocalStore::MockLocalStore(QObject *parent) :
 	LocalStore(parent),
 	mutex(QMutex::Recursive),
 	enabled(false),
 	pseudoStore(),
-	failCount(0)
+	failCount(0),
+	sequence(0),
+	horizon(0),
+	changeLog()
 {}
 
 QList<QtDataSync::ObjectKey> MockLocalStore::loadAllKeys()
@@ -24,15 +28,18 @@ void MockLocalStore::resetStore()
 	QMutexLocker _(&mutex);
 	if(!enabled)
 		return;
-	else
+	else {
 		pseudoStore.clear();
+		changeLog.clear();
+		horizon = sequence;
+	}
 }
 
 void MockLocalStore::count(quint64 id, const QByteArray &typeName)
 {
 	QMutexLocker _(&mutex);
 	if(!enabled)
-		emit requestCompleted(id, 0);
+		emit requestResultReady(id, 0);
 	else if(failCount > 0)
 		emit requestFailed(id, QString::number(failCount--));
 	else {
@@ -42,7 +49,7 @@ void MockLocalStore::count(quint64 id, const QByteArray &typeName)
 				cnt++;
 		}
 
-		emit requestCompleted(id, cnt);
+		emit requestResultReady(id, cnt);
 	}
 }
 
@@ -50,7 +57,7 @@ void MockLocalStore::keys(quint64 id, const QByteArray &typeName)
 {
 	QMutexLocker _(&mutex);
 	if(!enabled)
-		emit requestCompleted(id, QJsonArray());
+		emit requestResultReady(id, QStringList());
 	else if(failCount > 0)
 		emit requestFailed(id, QString::number(failCount--));
 	else {
@@ -60,7 +67,7 @@ void MockLocalStore::keys(quint64 id, const QByteArray &typeName)
 				keys.append(key.second);
 		}
 
-		emit requestCompleted(id, QJsonArray::fromStringList(keys));
+		emit requestResultReady(id, keys);
 	}
 }
 
@@ -82,6 +89,31 @@ void MockLocalStore::loadAll(quint64 id, const QByteArray &typeName)
 	}
 }
 
+void MockLocalStore::loadAllProjected(quint64 id, const QByteArray &typeName, const QStringList &properties)
+{
+	QMutexLocker _(&mutex);
+	if(!enabled)
+		emit requestCompleted(id, QJsonArray());
+	else if(failCount > 0)
+		emit requestFailed(id, QString::number(failCount--));
+	else {
+		QJsonArray data;
+		foreach(auto key, pseudoStore.keys()) {
+			if(key.first == typeName) {
+				auto object = pseudoStore[key];
+				QJsonObject projection;
+				foreach(auto property, properties) {
+					if(object.contains(property))
+						projection.insert(property, object[property]);
+				}
+				data.append(projection);
+			}
+		}
+
+		emit requestCompleted(id, data);
+	}
+}
+
 void MockLocalStore::load(quint64 id, const QtDataSync::ObjectKey &key, const QByteArray &)
 {
 	QMutexLocker _(&mutex);
@@ -97,6 +129,25 @@ void MockLocalStore::load(quint64 id, const QtDataSync::ObjectKey &key, const QB
 	}
 }
 
+void MockLocalStore::loadMany(quint64 id, const QByteArray &typeName, const QStringList &keys, const QByteArray &)
+{
+	QMutexLocker _(&mutex);
+	if(!enabled)
+		emit requestCompleted(id, QJsonObject());
+	else if(failCount > 0)
+		emit requestFailed(id, QString::number(failCount--));
+	else {
+		QJsonObject data;
+		foreach(auto key, keys) {
+			auto it = pseudoStore.constFind({typeName, key});
+			if(it != pseudoStore.constEnd())
+				data.insert(key, *it);
+		}
+
+		emit requestCompleted(id, data);
+	}
+}
+
 void MockLocalStore::save(quint64 id, const QtDataSync::ObjectKey &key, const QJsonObject &object, const QByteArray &)
 {
 	QMutexLocker _(&mutex);
@@ -106,6 +157,7 @@ void MockLocalStore::save(quint64 id, const QtDataSync::ObjectKey &key, const QJ
 		emit requestFailed(id, QString::number(failCount--));
 	else {
 		pseudoStore.insert(key, object);
+		changeLog.insert(key, {++sequence, false});
 		emit requestCompleted(id, QJsonValue::Undefined);
 	}
 }
@@ -114,11 +166,14 @@ void MockLocalStore::remove(quint64 id, const QtDataSync::ObjectKey &key, const
 {
 	QMutexLocker _(&mutex);
 	if(!enabled)
-		emit requestCompleted(id, QJsonValue::Undefined);
+		emit requestResultReady(id, false);
 	else if(failCount > 0)
 		emit requestFailed(id, QString::number(failCount--));
-	else
-		emit requestCompleted(id, pseudoStore.remove(key) > 0);
+	else if(pseudoStore.remove(key) > 0) {
+		changeLog.insert(key, {++sequence, true});
+		emit requestResultReady(id, true);
+	} else
+		emit requestResultReady(id, false);
 }
 
 void MockLocalStore::search(quint64 id, const QByteArray &typeName, const QString &searchQuery)
@@ -139,3 +194,27 @@ void MockLocalStore::search(quint64 id, const QByteArray &typeName, const QStrin
 		emit requestCompleted(id, data);
 	}
 }
+
+void MockLocalStore::changesSince(quint64 id, const QByteArray &typeName, quint64 sequence)
+{
+	QMutexLocker _(&mutex);
+	QtDataSync::ChangeSet changeSet;
+	if(!enabled)
+		emit requestResultReady(id, QVariant::fromValue(changeSet));
+	else if(failCount > 0)
+		emit requestFailed(id, QString::number(failCount--));
+	else {
+		changeSet.sequence = this->sequence;
+		changeSet.complete = sequence >= horizon && sequence <= this->sequence;
+		for(auto it = changeLog.constBegin(); it != changeLog.constEnd(); it++) {
+			if(it.key().first != typeName || it->first <= sequence)
+				continue;
+			if(it->second)
+				changeSet.deleted.append(it.key().second);
+			else
+				changeSet.changed.append(it.key().second);
+		}
+
+		emit requestResultReady(id, QVariant::fromValue(changeSet));
+	}
+}
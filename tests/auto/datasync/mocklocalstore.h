@@ -19,16 +19,22 @@ public slots:
 	void count(quint64 id, const QByteArray &typeName) override;
 	void keys(quint64 id, const QByteArray &typeName) override;
 	void loadAll(quint64 id, const QByteArray &typeName) override;
+	void loadAllProjected(quint64 id, const QByteArray &typeName, const QStringList &properties) override;
 	void load(quint64 id, const QtDataSync::ObjectKey &key, const QByteArray &keyProperty) override;
+	void loadMany(quint64 id, const QByteArray &typeName, const QStringList &keys, const QByteArray &keyProperty) override;
 	void save(quint64 id, const QtDataSync::ObjectKey &key, const QJsonObject &object, const QByteArray &keyProperty) override;
 	void remove(quint64 id, const QtDataSync::ObjectKey &key, const QByteArray &keyProperty) override;
 	void search(quint64 id, const QByteArray &typeName, const QString &searchQuery) override;
+	void changesSince(quint64 id, const QByteArray &typeName, quint64 sequence) override;
 
 public:
 	QMutex mutex;
 	bool enabled;
 	QHash<QtDataSync::ObjectKey, QJsonObject> pseudoStore;
 	int failCount;
+	quint64 sequence;
+	quint64 horizon;
+	QHash<QtDataSync::ObjectKey, QPair<quint64, bool>> changeLog;
 };
 
 #endif // MOCKLOCALSTORE_H
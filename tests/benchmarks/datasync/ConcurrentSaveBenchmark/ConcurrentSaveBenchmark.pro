@@ -0,0 +1,16 @@
+QT       += testlib
+
+QT       -= gui
+
+include(../../../auto/datasync/tests.pri)
+
+TARGET = tst_concurrentsave
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += tst_concurrentsave.cpp
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
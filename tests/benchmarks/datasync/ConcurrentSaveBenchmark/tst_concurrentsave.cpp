@@ -0,0 +1,132 @@
+#include <QString>
+#include <QtTest>
+#include <QCoreApplication>
+#include "tst.h"
+using namespace QtDataSync;
+
+class LargeData
+{
+	Q_GADGET
+
+	Q_PROPERTY(int id MEMBER id USER true)
+	Q_PROPERTY(QStringList lines MEMBER lines)
+	Q_PROPERTY(QVariantMap attributes MEMBER attributes)
+
+public:
+	LargeData(int id = -1);
+
+	int id;
+	QStringList lines;
+	QVariantMap attributes;
+};
+
+class SaveRunnable : public QRunnable
+{
+public:
+	SaveRunnable(int offset, int count);
+
+	void run() override;
+
+private:
+	int offset;
+	int count;
+};
+
+class ConcurrentSaveBenchmark : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void benchmarkConcurrentSave_data();
+	void benchmarkConcurrentSave();
+
+private:
+	MockLocalStore *store;
+};
+
+static const int SavesPerThread = 50;
+
+void ConcurrentSaveBenchmark::initTestCase()
+{
+#ifdef Q_OS_LINUX
+	Q_ASSERT(qgetenv("LD_PRELOAD").contains("Qt5DataSync"));
+#endif
+
+	tst_init();
+
+	Setup setup;
+	mockSetup(setup);
+	store = static_cast<MockLocalStore*>(setup.localStore());
+	store->enabled = true;
+	setup.create();
+}
+
+void ConcurrentSaveBenchmark::cleanupTestCase()
+{
+	Setup::removeSetup(Setup::DefaultSetup);
+}
+
+void ConcurrentSaveBenchmark::benchmarkConcurrentSave_data()
+{
+	QTest::addColumn<int>("threads");
+
+	QTest::newRow("1") << 1;
+	QTest::newRow("2") << 2;
+	QTest::newRow("4") << 4;
+	QTest::newRow("8") << 8;
+}
+
+void ConcurrentSaveBenchmark::benchmarkConcurrentSave()
+{
+	QFETCH(int, threads);
+
+	store->mutex.lock();
+	store->pseudoStore.clear();
+	store->mutex.unlock();
+
+	QBENCHMARK {
+		QThreadPool pool;
+		pool.setMaxThreadCount(threads);
+		for(auto i = 0; i < threads; i++)
+			pool.start(new SaveRunnable(i * SavesPerThread, SavesPerThread));
+		pool.waitForDone();
+	}
+
+	store->mutex.lock();
+	QCOMPARE(store->pseudoStore.size(), threads * SavesPerThread);
+	store->mutex.unlock();
+}
+
+LargeData::LargeData(int id) :
+	id(id),
+	lines(),
+	attributes()
+{
+	for(auto i = 0; i < 500; i++) {
+		lines.append(QStringLiteral("line %1 of dataset %2").arg(i).arg(id));
+		attributes.insert(QStringLiteral("attribute%1").arg(i), i * id);
+	}
+}
+
+SaveRunnable::SaveRunnable(int offset, int count) :
+	QRunnable(),
+	offset(offset),
+	count(count)
+{}
+
+void SaveRunnable::run()
+{
+	AsyncDataStore async;
+	QList<GenericTask<void>> tasks;
+	for(auto i = offset; i < offset + count; i++)
+		tasks.append(async.save<LargeData>(LargeData(i)));
+	foreach(auto task, tasks)
+		task.waitForFinished();
+}
+
+QTEST_MAIN(ConcurrentSaveBenchmark)
+
+#include "tst_concurrentsave.moc"
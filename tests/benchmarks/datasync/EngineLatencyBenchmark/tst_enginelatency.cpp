@@ -0,0 +1,114 @@
+#include <QString>
+#include <QtTest>
+#include <QCoreApplication>
+#include "tst.h"
+using namespace QtDataSync;
+
+class EngineLatencyBenchmark : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void benchmarkRoundTrip_data();
+	void benchmarkRoundTrip();
+	void benchmarkKeys_data();
+	void benchmarkKeys();
+
+private:
+	AsyncDataStore *async;
+	MockLocalStore *store;
+};
+
+//requests are performed one after another, so each iteration measures the full round trip
+static const int RequestCount = 100;
+
+void EngineLatencyBenchmark::initTestCase()
+{
+#ifdef Q_OS_LINUX
+	Q_ASSERT(qgetenv("LD_PRELOAD").contains("Qt5DataSync"));
+#endif
+
+	tst_init();
+
+	Setup setup;
+	mockSetup(setup);
+	store = static_cast<MockLocalStore*>(setup.localStore());
+	store->enabled = true;
+	setup.create();
+
+	async = new AsyncDataStore(this);
+}
+
+void EngineLatencyBenchmark::cleanupTestCase()
+{
+	delete async;
+	Setup::removeSetup(Setup::DefaultSetup);
+}
+
+void EngineLatencyBenchmark::benchmarkRoundTrip_data()
+{
+	QTest::addColumn<QString>("operation");
+
+	QTest::newRow("count") << QStringLiteral("count");
+	QTest::newRow("load") << QStringLiteral("load");
+	QTest::newRow("save") << QStringLiteral("save");
+}
+
+void EngineLatencyBenchmark::benchmarkRoundTrip()
+{
+	QFETCH(QString, operation);
+
+	store->mutex.lock();
+	store->pseudoStore = generateDataJson(0, RequestCount);
+	store->mutex.unlock();
+
+	try {
+		QBENCHMARK {
+			for(auto i = 0; i < RequestCount; i++) {
+				if(operation == QStringLiteral("count"))
+					async->count<TestData>().waitForFinished();
+				else if(operation == QStringLiteral("load"))
+					async->load<TestData>(i).waitForFinished();
+				else
+					async->save<TestData>(generateData(i)).waitForFinished();
+			}
+		}
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void EngineLatencyBenchmark::benchmarkKeys_data()
+{
+	QTest::addColumn<int>("size");
+
+	QTest::newRow("1000") << 1000;
+	QTest::newRow("10000") << 10000;
+	QTest::newRow("100000") << 100000;
+}
+
+void EngineLatencyBenchmark::benchmarkKeys()
+{
+	QFETCH(int, size);
+
+	store->mutex.lock();
+	store->pseudoStore = generateDataJson(0, size);
+	store->mutex.unlock();
+
+	try {
+		QStringList keys;
+		QBENCHMARK {
+			keys = async->keys<TestData>().result();
+		}
+		QCOMPARE(keys.size(), size);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+QTEST_MAIN(EngineLatencyBenchmark)
+
+#include "tst_enginelatency.moc"
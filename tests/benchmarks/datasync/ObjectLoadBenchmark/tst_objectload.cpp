@@ -0,0 +1,124 @@
+#include <QString>
+#include <QtTest>
+#include <QCoreApplication>
+#include "tst.h"
+using namespace QtDataSync;
+
+class ObjectLoadBenchmark : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void benchmarkLoadAll_data();
+	void benchmarkLoadAll();
+	void benchmarkLoadMany_data();
+	void benchmarkLoadMany();
+
+private:
+	AsyncDataStore *async;
+	MockLocalStore *store;
+};
+
+static const int ObjectCount = 50000;
+
+void ObjectLoadBenchmark::initTestCase()
+{
+#ifdef Q_OS_LINUX
+	Q_ASSERT(qgetenv("LD_PRELOAD").contains("Qt5DataSync"));
+#endif
+
+	tst_init();
+
+	Setup setup;
+	mockSetup(setup);
+	store = static_cast<MockLocalStore*>(setup.localStore());
+	store->enabled = true;
+	setup.create();
+
+	async = new AsyncDataStore(this);
+
+	DataSet data;
+	for(auto i = 0; i < ObjectCount; i++)
+		data.insert({"TestObject*", QString::number(i)}, generateDataJson(i));
+	store->mutex.lock();
+	store->pseudoStore = data;
+	store->mutex.unlock();
+}
+
+void ObjectLoadBenchmark::cleanupTestCase()
+{
+	delete async;
+	Setup::removeSetup(Setup::DefaultSetup);
+}
+
+void ObjectLoadBenchmark::benchmarkLoadAll_data()
+{
+	QTest::addColumn<bool>("useHandler");
+
+	QTest::newRow("result") << false;
+	QTest::newRow("onResult") << true;
+}
+
+void ObjectLoadBenchmark::benchmarkLoadAll()
+{
+	QFETCH(bool, useHandler);
+
+	try {
+		QList<TestObject*> objects;
+		QBENCHMARK {
+			qDeleteAll(objects);
+			if(useHandler) {
+				auto done = false;
+				async->loadAll<TestObject*>().onResult(this, [&](QList<TestObject*> result){
+					objects = result;
+					done = true;
+				});
+				QTRY_VERIFY(done);
+			} else
+				objects = async->loadAll<TestObject*>().result();
+		}
+
+		QCOMPARE(objects.size(), ObjectCount);
+		foreach(auto object, objects)
+			QCOMPARE(object->thread(), thread());
+		qDeleteAll(objects);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void ObjectLoadBenchmark::benchmarkLoadMany_data()
+{
+	QTest::addColumn<int>("windowSize");
+
+	QTest::newRow("100") << 100;
+	QTest::newRow("1000") << 1000;
+	QTest::newRow("50000") << ObjectCount;
+}
+
+void ObjectLoadBenchmark::benchmarkLoadMany()
+{
+	QFETCH(int, windowSize);
+
+	auto keys = generateDataKeys(0, ObjectCount);
+	try {
+		QBENCHMARK {
+			auto loaded = 0;
+			for(auto offset = 0; offset < ObjectCount; offset += windowSize) {
+				auto window = async->loadMany<TestObject*>(keys.mid(offset, windowSize)).result();
+				loaded += window.size();
+				qDeleteAll(window);
+			}
+			QCOMPARE(loaded, ObjectCount);
+		}
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+QTEST_MAIN(ObjectLoadBenchmark)
+
+#include "tst_objectload.moc"
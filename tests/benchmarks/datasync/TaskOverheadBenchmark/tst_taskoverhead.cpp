@@ -0,0 +1,86 @@
+#include <QString>
+#include <QtTest>
+#include <QCoreApplication>
+#include "tst.h"
+using namespace QtDataSync;
+
+class TaskOverheadBenchmark : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void benchmarkOnResult_data();
+	void benchmarkOnResult();
+
+private:
+	AsyncDataStore *async;
+	MockLocalStore *store;
+};
+
+void TaskOverheadBenchmark::initTestCase()
+{
+#ifdef Q_OS_LINUX
+	Q_ASSERT(qgetenv("LD_PRELOAD").contains("Qt5DataSync"));
+#endif
+
+	tst_init();
+
+	Setup setup;
+	mockSetup(setup);
+	store = static_cast<MockLocalStore*>(setup.localStore());
+	store->enabled = true;
+	setup.create();
+
+	async = new AsyncDataStore(this);
+}
+
+void TaskOverheadBenchmark::cleanupTestCase()
+{
+	delete async;
+	Setup::removeSetup(Setup::DefaultSetup);
+}
+
+void TaskOverheadBenchmark::benchmarkOnResult_data()
+{
+	QTest::addColumn<bool>("useWatcher");
+	QTest::addColumn<int>("tasks");
+
+	QTest::newRow("continuation/1000") << false << 1000;
+	QTest::newRow("watcher/1000") << true << 1000;
+	QTest::newRow("continuation/10000") << false << 10000;
+	QTest::newRow("watcher/10000") << true << 10000;
+}
+
+void TaskOverheadBenchmark::benchmarkOnResult()
+{
+	QFETCH(bool, useWatcher);
+	QFETCH(int, tasks);
+
+	QBENCHMARK {
+		auto finished = 0;
+		for(auto i = 0; i < tasks; i++) {
+			auto task = async->count<TestData>();
+			if(useWatcher) {
+				//what onResult did before, one watcher object per task
+				auto watcher = new QFutureWatcher<QVariant>(this);
+				connect(watcher, &QFutureWatcherBase::finished, watcher, [watcher, &finished](){
+					finished++;
+					watcher->deleteLater();
+				});
+				watcher->setFuture(task);
+			} else {
+				task.onResult(this, [&finished](int){
+					finished++;
+				});
+			}
+		}
+		QTRY_COMPARE(finished, tasks);
+	}
+}
+
+QTEST_MAIN(TaskOverheadBenchmark)
+
+#include "tst_taskoverhead.moc"
@@ -0,0 +1,7 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+	ConcurrentSaveBenchmark \
+	EngineLatencyBenchmark \
+	ObjectLoadBenchmark \
+	TaskOverheadBenchmark
@@ -4,5 +4,8 @@ CONFIG += no_docs_target
 
 SUBDIRS += auto
 
+#benchmarks are only built on request, e.g. "qmake CONFIG+=benchmarks"
+benchmarks: SUBDIRS += benchmarks
+
 docTarget.target = doxygen
 QMAKE_EXTRA_TARGETS += docTarget